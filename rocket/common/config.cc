@@ -1,27 +1,81 @@
 #include "rocket/common/config.h"
 
+#include <signal.h>
+#include <sys/stat.h>
 #include <tinyxml/tinyxml.h>
 
-#define READ_XML_NODE(name, parent)                                         \
-  TiXmlElement *name##_node = parent->FirstChildElement(#name);             \
-  if (!name##_node) {                                                       \
-    printf("Start rocket server error, failed to read node [%s]\n", #name); \
-    exit(0);                                                                \
-  }
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
 
-#define READ_STR_FROM_XML_NODE(name, parent)                             \
-  TiXmlElement *name##_node = parent->FirstChildElement(#name);          \
-  if (!name##_node || !name##_node->GetText()) {                         \
-    printf("Start rocket server error, failed to read config file %s\n", \
-           #name);                                                       \
-    exit(0);                                                             \
-  }                                                                      \
-  std::string name##_str = std::string(name##_node->GetText());
+#include "rocket/common/log.h"
+#include "rocket/common/mutex.h"
 
 namespace rocket {
 
 static Config *g_config = NULL;
 
+// 模块在静态初始化阶段注册监听者，用局部静态变量保证先于使用构造
+static Mutex &GetListenersMutex() {
+  static Mutex *mutex = new Mutex();
+  return *mutex;
+}
+
+static std::vector<Config::Listener> &GetListeners() {
+  static std::vector<Config::Listener> *listeners =
+      new std::vector<Config::Listener>();
+  return *listeners;
+}
+
+static std::atomic<bool> g_reload_signaled{false};  // 收到了SIGHUP
+
+// 读取可选的字符串配置，节点不存在时保持默认值
+static void ReadStrFromXmlNode(TiXmlElement *parent, const char *name,
+                               std::string &value) {
+  TiXmlElement *node = parent->FirstChildElement(name);
+  if (!node || !node->GetText()) {
+    printf("Config warning, node [%s] not found, use default [%s]\n", name,
+           value.c_str());
+    return;
+  }
+  value = std::string(node->GetText());
+}
+
+// 读取可选的整数配置，节点不存在时保持默认值，超出[min_value, max_value]时截断
+static void ReadIntFromXmlNode(TiXmlElement *parent, const char *name,
+                               int &value, int min_value, int max_value) {
+  TiXmlElement *node = parent->FirstChildElement(name);
+  if (!node || !node->GetText()) {
+    printf("Config warning, node [%s] not found, use default [%d]\n", name,
+           value);
+    return;
+  }
+  long long number = std::atoll(node->GetText());
+  if (number < min_value || number > max_value) {
+    value = number < min_value ? min_value : max_value;
+    printf("Config warning, node [%s] value [%s] out of range [%d, %d], use "
+           "[%d]\n",
+           name, node->GetText(), min_value, max_value, value);
+    return;
+  }
+  value = static_cast<int>(number);
+}
+
+// 返回文件的修改时间(ns)，文件不存在时返回0
+static int64_t GetFileMtime(const std::string &file) {
+  struct stat st;
+  if (stat(file.c_str(), &st) != 0) {
+    return 0;
+  }
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+         st.st_mtim.tv_nsec;
+}
+
+static void OnReloadSignal(int) {
+  g_reload_signaled.store(true, std::memory_order_relaxed);
+}
+
 Config *Config::GetGlobalConfig() { return g_config; }
 
 void Config::SetGlobalConfig(const char *xmlfile) {
@@ -31,13 +85,45 @@ void Config::SetGlobalConfig(const char *xmlfile) {
     } else {
       g_config = new Config();
     }
+    g_config->apply();
   }
 }
 
-Config::Config() { m_log_level = "DEBUG"; };
+Config::Config(){};
 
 Config::Config(const char *xmlfile) {
-  TiXmlDocument *xml_document = new TiXmlDocument();
+  if (!load(xmlfile)) {
+    exit(0);
+  }
+
+  printf(
+      "LOG -- CONFIG LEVEL[%s], FILE_NAME[%s],FILE_PATH[%s] MAX_FILE_SIZE[%d "
+      "Byte], SYNC_INTEVAL[%d ms], WRITER[%s]\n",
+      m_log_level.c_str(), m_log_file_name.c_str(), m_log_file_path.c_str(),
+      m_log_max_file_size, m_log_sync_inteval,
+      m_log_writer.empty() ? "file" : m_log_writer.c_str());
+
+  printf("Server -- PORT[%d], IO Threads[%d], ADMIN_PORT[%d]\n", m_port,
+         m_io_threads, m_admin_port);
+
+  printf(
+      "Tunables -- TCP_BUFFER_SIZE[%d], EPOLL_TIMEOUT[%d ms], "
+      "EPOLL_MAX_EVENTS[%d, %d], BUSY_POLL[%d us, %d us], RPC_TIMEOUT[%d ms], "
+      "STALL_THRESHOLD[%d ms, stack %d], RELOAD_INTERVAL[%d ms], "
+      "OUTPUT_WATERMARK[%d, %d Byte], SLOW_CLIENT[%d Byte, %d ms, %s], "
+      "MAX_CONCURRENCY[%d, adaptive %d]\n",
+      m_tcp_buffer_size, m_epoll_timeout, m_epoll_max_events,
+      m_epoll_max_events_limit, m_busy_poll_us, m_socket_busy_poll_us,
+      m_rpc_timeout, m_stall_threshold, m_stall_capture_stack,
+      m_reload_interval,
+      m_output_high_watermark, m_output_low_watermark,
+      m_slow_client_buffer_limit, m_slow_client_timeout,
+      m_slow_client_action.c_str(), m_max_concurrency,
+      m_adaptive_concurrency);
+}
+
+bool Config::load(const char *xmlfile) {
+  std::unique_ptr<TiXmlDocument> xml_document(new TiXmlDocument());
 
   bool rt = xml_document->LoadFile(xmlfile);
 
@@ -46,40 +132,213 @@ Config::Config(const char *xmlfile) {
         "Start rocket server error, failed to read config file %s, error "
         "info[%s] \n",
         xmlfile, xml_document->ErrorDesc());
+    return false;
+  }
 
-    exit(0);
+  TiXmlElement *root_node = xml_document->FirstChildElement("root");
+  if (!root_node) {
+    printf("Start rocket server error, failed to read node [root] in %s\n",
+           xmlfile);
+    return false;
   }
+  m_config_file = xmlfile;
+  m_file_mtime = GetFileMtime(m_config_file);
 
-  READ_XML_NODE(root, xml_document);
-  READ_XML_NODE(log, root_node);
-  READ_XML_NODE(server, root_node);
+  // 缺少整个节点时用一个空节点代替，其下的配置项全部使用默认值
+  TiXmlElement empty_node("empty");
+  TiXmlElement *log_node = root_node->FirstChildElement("log");
+  if (!log_node) {
+    printf("Config warning, node [log] not found\n");
+    log_node = &empty_node;
+  }
+  TiXmlElement *server_node = root_node->FirstChildElement("server");
+  if (!server_node) {
+    printf("Config warning, node [server] not found\n");
+    server_node = &empty_node;
+  }
 
-  READ_STR_FROM_XML_NODE(log_level, log_node);
-  READ_STR_FROM_XML_NODE(log_file_name, log_node);
-  READ_STR_FROM_XML_NODE(log_file_path, log_node);
-  READ_STR_FROM_XML_NODE(log_max_file_size, log_node);
-  READ_STR_FROM_XML_NODE(log_sync_interval, log_node);
+  ReadStrFromXmlNode(log_node, "log_level", m_log_level);
+  if (StringToLogLevel(m_log_level) == Unknown) {
+    printf("Config warning, unknown log_level [%s], use [DEBUG]\n",
+           m_log_level.c_str());
+    m_log_level = "DEBUG";
+  }
+  ReadStrFromXmlNode(log_node, "log_file_name", m_log_file_name);
+  ReadStrFromXmlNode(log_node, "log_file_path", m_log_file_path);
+  ReadIntFromXmlNode(log_node, "log_max_file_size", m_log_max_file_size, 4096,
+                     INT32_MAX);
+  ReadIntFromXmlNode(log_node, "log_sync_interval", m_log_sync_inteval, 1,
+                     60 * 1000);
 
-  m_log_level = log_level_str;
+  // 可选配置
+  TiXmlElement *log_writer_node = log_node->FirstChildElement("log_writer");
+  if (log_writer_node && log_writer_node->GetText()) {
+    m_log_writer = std::string(log_writer_node->GetText());
+  }
 
-  m_log_file_name = log_file_name_str;
-  m_log_file_path = log_file_path_str;
-  m_log_max_file_size = std::atoi(log_max_file_size_str.c_str());
-  m_log_sync_inteval = std::atoi(log_sync_interval_str.c_str());
+  ReadIntFromXmlNode(server_node, "port", m_port, 0, 65535);
+  ReadIntFromXmlNode(server_node, "io_threads", m_io_threads, 1, 256);
+  ReadIntFromXmlNode(server_node, "admin_port", m_admin_port, 0, 65535);
 
-  printf(
-      "LOG -- CONFIG LEVEL[%s], FILE_NAME[%s],FILE_PATH[%s] MAX_FILE_SIZE[%d "
-      "Byte], SYNC_INTEVAL[%d ms]\n",
-      m_log_level.c_str(), m_log_file_name.c_str(), m_log_file_path.c_str(),
-      m_log_max_file_size, m_log_sync_inteval);
+  // 性能相关配置都是可选的，只在需要调整时写进配置文件
+  TiXmlElement *tunables_node = root_node->FirstChildElement("tunables");
+  if (tunables_node) {
+    ReadIntFromXmlNode(tunables_node, "tcp_buffer_size", m_tcp_buffer_size, 64,
+                       64 * 1024 * 1024);
+    ReadIntFromXmlNode(tunables_node, "epoll_timeout", m_epoll_timeout, 1,
+                       60 * 1000);
+    ReadIntFromXmlNode(tunables_node, "epoll_max_events", m_epoll_max_events,
+                       1, 65536);
+    ReadIntFromXmlNode(tunables_node, "epoll_max_events_limit",
+                       m_epoll_max_events_limit, m_epoll_max_events, 65536);
+    ReadIntFromXmlNode(tunables_node, "busy_poll_us", m_busy_poll_us, 0,
+                       1000 * 1000);
+    ReadIntFromXmlNode(tunables_node, "socket_busy_poll_us",
+                       m_socket_busy_poll_us, 0, 1000 * 1000);
+    ReadIntFromXmlNode(tunables_node, "rpc_timeout", m_rpc_timeout, 1,
+                       3600 * 1000);
+    ReadIntFromXmlNode(tunables_node, "stall_threshold", m_stall_threshold, 0,
+                       3600 * 1000);
+    int stall_capture_stack = m_stall_capture_stack ? 1 : 0;
+    ReadIntFromXmlNode(tunables_node, "stall_capture_stack",
+                       stall_capture_stack, 0, 1);
+    m_stall_capture_stack = stall_capture_stack != 0;
+    ReadIntFromXmlNode(tunables_node, "reload_interval", m_reload_interval, 0,
+                       3600 * 1000);
+    ReadIntFromXmlNode(tunables_node, "output_high_watermark",
+                       m_output_high_watermark, 0, INT32_MAX);
+    ReadIntFromXmlNode(tunables_node, "output_low_watermark",
+                       m_output_low_watermark, 0, m_output_high_watermark);
+    ReadIntFromXmlNode(tunables_node, "max_concurrency", m_max_concurrency, 0,
+                       INT32_MAX);
+    int adaptive_concurrency = m_adaptive_concurrency ? 1 : 0;
+    ReadIntFromXmlNode(tunables_node, "adaptive_concurrency",
+                       adaptive_concurrency, 0, 1);
+    m_adaptive_concurrency = adaptive_concurrency != 0;
+    ReadIntFromXmlNode(tunables_node, "slow_client_buffer_limit",
+                       m_slow_client_buffer_limit, 0, INT32_MAX);
+    ReadIntFromXmlNode(tunables_node, "slow_client_timeout",
+                       m_slow_client_timeout, 0, 3600 * 1000);
+    ReadStrFromXmlNode(tunables_node, "slow_client_action",
+                       m_slow_client_action);
+    if (m_slow_client_action != "close" && m_slow_client_action != "throttle") {
+      printf("Config warning, unknown slow_client_action [%s], use [close]\n",
+             m_slow_client_action.c_str());
+      m_slow_client_action = "close";
+    }
+  }
+
+  return true;
+}
+
+bool Config::reload() {
+  // 先记录修改时间，文件内容有误时不会反复重试，等下一次修改
+  m_file_mtime = GetFileMtime(m_config_file);
+  Config config;
+  if (!config.load(m_config_file.c_str())) {
+    ERRORLOG("reload config [%s] failed, keep current config",
+             m_config_file.c_str());
+    return false;
+  }
+
+  if (config.m_log_file_name != m_log_file_name ||
+      config.m_log_file_path != m_log_file_path ||
+      config.m_log_sync_inteval != m_log_sync_inteval ||
+      config.m_log_writer != m_log_writer || config.m_port != m_port ||
+      config.m_io_threads != m_io_threads ||
+      config.m_admin_port != m_admin_port ||
+      config.m_epoll_max_events != m_epoll_max_events ||
+      config.m_epoll_max_events_limit != m_epoll_max_events_limit ||
+      config.m_busy_poll_us != m_busy_poll_us ||
+      config.m_socket_busy_poll_us != m_socket_busy_poll_us ||
+      config.m_reload_interval != m_reload_interval) {
+    INFOLOG("config [%s] changed options that only take effect after restart",
+            m_config_file.c_str());
+  }
 
-  READ_STR_FROM_XML_NODE(port, server_node);
-  READ_STR_FROM_XML_NODE(io_threads, server_node);
+  m_log_level = config.m_log_level;
+  m_log_max_file_size = config.m_log_max_file_size;
+  m_tcp_buffer_size = config.m_tcp_buffer_size;
+  m_epoll_timeout = config.m_epoll_timeout;
+  m_rpc_timeout = config.m_rpc_timeout;
+  m_stall_threshold = config.m_stall_threshold;
+  m_stall_capture_stack = config.m_stall_capture_stack;
+  m_output_high_watermark = config.m_output_high_watermark;
+  m_output_low_watermark = config.m_output_low_watermark;
+  m_max_concurrency = config.m_max_concurrency;
+  m_adaptive_concurrency = config.m_adaptive_concurrency;
+  m_slow_client_buffer_limit = config.m_slow_client_buffer_limit;
+  m_slow_client_timeout = config.m_slow_client_timeout;
+  m_slow_client_action = config.m_slow_client_action;
+  apply();
 
-  m_port = std::atoi(port_str.c_str());
-  m_io_threads = std::atoi(io_threads_str.c_str());
+  INFOLOG(
+      "reload config [%s] success, LEVEL[%s], MAX_FILE_SIZE[%d], "
+      "TCP_BUFFER_SIZE[%d], EPOLL_TIMEOUT[%d ms], RPC_TIMEOUT[%d ms], "
+      "STALL_THRESHOLD[%d ms, stack %d], OUTPUT_WATERMARK[%d, %d Byte], "
+      "SLOW_CLIENT[%d Byte, %d ms, %s], MAX_CONCURRENCY[%d, adaptive %d]",
+      m_config_file.c_str(), m_log_level.c_str(), m_log_max_file_size,
+      m_tcp_buffer_size, m_epoll_timeout, m_rpc_timeout, m_stall_threshold,
+      m_stall_capture_stack, m_output_high_watermark, m_output_low_watermark,
+      m_slow_client_buffer_limit, m_slow_client_timeout,
+      m_slow_client_action.c_str(), m_max_concurrency, m_adaptive_concurrency);
+  return true;
+}
+
+void Config::apply() const {
+  Logger *logger = Logger::GetGlobalLogger();
+  if (logger) {
+    logger->setLogLevel(StringToLogLevel(m_log_level));
+    logger->setMaxFileSize(m_log_max_file_size);
+  }
+
+  ScopeMutex<Mutex> lock(GetListenersMutex());
+  std::vector<Listener> listeners = GetListeners();
+  lock.unlock();
+  for (auto &listener : listeners) {
+    listener(*this);
+  }
+}
 
-  printf("Server -- PORT[%d], IO Threads[%d]\n", m_port, m_io_threads);
+void Config::AddListener(Listener listener) {
+  ScopeMutex<Mutex> lock(GetListenersMutex());
+  GetListeners().push_back(listener);
+  lock.unlock();
+  if (g_config != NULL) {
+    listener(*g_config);
+  }
+}
+
+int Config::EnableHotReload() {
+  static bool g_enabled = false;
+  if (g_config == NULL || g_config->m_config_file.empty() || g_enabled) {
+    return 0;
+  }
+  g_enabled = true;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnReloadSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGHUP, &action, nullptr);
+
+  // m_reload_interval 为0时不检查文件，但仍按1s的间隔响应SIGHUP
+  int interval =
+      g_config->m_reload_interval > 0 ? g_config->m_reload_interval : 1000;
+  INFOLOG("config hot reload enabled, file [%s], check interval [%d ms]",
+          g_config->m_config_file.c_str(), interval);
+  return interval;
+}
+
+void Config::CheckReload() {
+  bool signaled = g_reload_signaled.exchange(false);
+  bool modified = g_config->m_reload_interval > 0 &&
+                  GetFileMtime(g_config->m_config_file) !=
+                      g_config->m_file_mtime;
+  if (signaled || modified) {
+    g_config->reload();
+  }
 }
 
-}  // namespace rocket
\ No newline at end of file
+}  // namespace rocket
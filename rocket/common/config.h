@@ -1,32 +1,106 @@
 #ifndef ROCKET_COMMON_CONFIG_H
 #define ROCKET_COMMON_CONFIG_H
 
+#include <stdint.h>
+
+#include <functional>
 #include <map>
+#include <string>
 
 namespace rocket {
 
+// 配置项都有默认值，配置文件中缺少的节点使用默认值，超出范围的值会被截断到合法范围。
+// 标记为 [热加载] 的配置项在收到 SIGHUP 或配置文件被修改后立即生效，
+// 其余配置项需要重启进程才能生效
 class Config {
  public:
+  using Listener = std::function<void(const Config &)>;
+
   Config(const char *xmlfile);
   Config();
 
+  // 解析配置文件，文件无法读取或格式错误时返回false
+  bool load(const char *xmlfile);
+
+  // 重新读取配置文件并应用热加载配置项，读取失败时保留当前配置，
+  // 只能在调用 CheckReload 的线程中调用
+  bool reload();
+
+  // 设置日志级别，并通知所有监听者
+  void apply() const;
+
  public:
   static Config *GetGlobalConfig();
   static void SetGlobalConfig(const char *xmlfile);
 
+  // 注册配置的监听者，各模块在其中读取自己的配置项。
+  // 全局配置已经存在时立即调用一次，之后在每次 reload 成功后调用。
+  // 第一次调用时日志还没有初始化，监听者中不能打日志
+  static void AddListener(Listener listener);
+
+  // 安装 SIGHUP 的处理函数，返回检查配置的间隔(ms)，调用者需要按这个间隔
+  // 定时调用 CheckReload。没有配置文件或已经启用过时返回0
+  static int EnableHotReload();
+
+  // 收到 SIGHUP 或配置文件被修改时调用 reload
+  static void CheckReload();
+
  public:
-  std::string m_log_level;
+  std::string m_config_file;  // 配置文件路径，为空表示使用默认配置
+
+  std::string m_log_level{"DEBUG"};  // [热加载]
 
   std::string m_log_file_name;
   std::string m_log_file_path;
-  int m_log_max_file_size{0};
+  int m_log_max_file_size{100 * 1024 * 1024};  // [热加载]
 
-  int m_log_sync_inteval{0};  // 日志同步间隔，单位ms
+  int m_log_sync_inteval{500};  // 日志同步间隔，单位ms
+
+  std::string m_log_writer;  // 日志文件写入方式，file(默认) 或 mmap
+
+  int m_port{0};        // 端口号
+  int m_io_threads{2};  // io线程数量
+  int m_admin_port{0};  // 管理端口，监听127.0.0.1，0表示不开启
+
+  int m_tcp_buffer_size{128};  // [热加载] 新连接读写缓冲区的初始大小
+  int m_epoll_timeout{10000};  // [热加载] epoll_wait的最长等待时间(ms)
+  int m_epoll_max_events{16};  // epoll_wait事件数组的初始大小
+  int m_epoll_max_events_limit{4096};  // epoll_wait事件数组的大小上限
+  int m_busy_poll_us{0};         // IO线程忙轮询的自旋预算(us)，0表示关闭
+  int m_socket_busy_poll_us{0};  // 连接的 SO_BUSY_POLL(us)，0表示不设置
+  int m_rpc_timeout{1000};       // [热加载] RpcController的默认超时时间(ms)
+  int m_stall_threshold{0};      // [热加载] 单个任务卡住loop多久(ms)报告一次，0表示关闭
+  bool m_stall_capture_stack{false};  // [热加载] 报告卡顿时是否抓取调用栈
+  int m_reload_interval{1000};   // 检查配置文件修改的间隔(ms)，0表示只响应SIGHUP
+
+  // [热加载] 服务端连接发送缓冲区的高低水位(字节)，超过高水位时暂停读取请求，
+  // 降到低水位以下后恢复，高水位为0表示不限制
+  int m_output_high_watermark{0};
+  int m_output_low_watermark{0};
+
+  // [热加载] 服务端同时处理的请求数上限，0表示不限制，超过的请求立即返回
+  // ERROR_SERVER_OVERLOADED。adaptive 时根据延迟自动调整上限，
+  // max_concurrency 作为上限的最大值
+  int m_max_concurrency{0};
+  bool m_adaptive_concurrency{false};
+
+  // [热加载] 慢客户端: 发送缓冲区积压超过limit字节，或有积压时超过timeout(ms)
+  // 没有发出任何数据，0表示不检查该条件，action 为 close(默认) 或 throttle
+  int m_slow_client_buffer_limit{0};
+  int m_slow_client_timeout{0};
+  std::string m_slow_client_action{"close"};
+
+ private:
+  int64_t m_file_mtime{0};  // 上次加载的配置文件修改时间(ns)
+};
 
-  int m_port{0};     // 端口号
-  int m_io_threads;  // io线程数量
+// 在模块的 .cc 中定义一个静态对象，程序启动时注册配置的监听者
+struct ConfigListenerRegistrar {
+  explicit ConfigListenerRegistrar(Config::Listener listener) {
+    Config::AddListener(std::move(listener));
+  }
 };
 
 }  // namespace rocket
 
-#endif
\ No newline at end of file
+#endif
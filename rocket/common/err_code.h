@@ -25,5 +25,9 @@ const int ERROR_PARSE_SERVICE_NAME =
     SYS_ERROR_PREFIX(0010);  // service name 解析失败
 const int ERROR_RPC_CHANNEL_INIT =
     SYS_ERROR_PREFIX(0011);  // rpc channel init error
+const int ERROR_SERVER_OVERLOADED =
+    SYS_ERROR_PREFIX(0012);  // 超过服务端并发上限，请求被拒绝
+const int ERROR_RPC_DEADLINE_EXCEEDED =
+    SYS_ERROR_PREFIX(0013);  // 请求在执行前已经超过调用方的截止时间
 
 #endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "rocket/common/histogram.h"
+
+#include "rocket/common/log.h"
+
+namespace rocket {
+
+LatencyHistogram::LatencyHistogram() {
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < 2 * SUB_BUCKET_COUNT) {
+    return value;
+  }
+  int msb = 63 - __builtin_clzll(value);
+  if (msb >= MAX_VALUE_BITS) {
+    return BUCKET_COUNT - 1;
+  }
+  // 取最高位之后的 SUB_BUCKET_BITS 位作为组内下标
+  int shift = msb - SUB_BUCKET_BITS;
+  size_t sub_index = (value >> shift) & (SUB_BUCKET_COUNT - 1);
+  return 2 * SUB_BUCKET_COUNT + (msb - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT +
+         sub_index;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < 2 * SUB_BUCKET_COUNT) {
+    return index;
+  }
+  if (index >= BUCKET_COUNT - 1) {
+    return UINT64_MAX;
+  }
+  size_t group = (index - 2 * SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+  size_t sub_index = (index - 2 * SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+  int shift = group + 1;
+  uint64_t lower = (SUB_BUCKET_COUNT + sub_index) << shift;
+  return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+  m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t old_min = m_min.load(std::memory_order_relaxed);
+  while (value < old_min &&
+         !m_min.compare_exchange_weak(old_min, value,
+                                      std::memory_order_relaxed)) {
+  }
+  uint64_t old_max = m_max.load(std::memory_order_relaxed);
+  while (value > old_max &&
+         !m_max.compare_exchange_weak(old_max, value,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::recordSingleWriter(uint64_t value) {
+  std::atomic<uint64_t> &bucket = m_buckets[BucketIndex(value)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  m_count.store(m_count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  m_sum.store(m_sum.load(std::memory_order_relaxed) + value,
+              std::memory_order_relaxed);
+  if (value < m_min.load(std::memory_order_relaxed)) {
+    m_min.store(value, std::memory_order_relaxed);
+  }
+  if (value > m_max.load(std::memory_order_relaxed)) {
+    m_max.store(value, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    uint64_t n = other.m_buckets[i].load(std::memory_order_relaxed);
+    if (n != 0) {
+      m_buckets[i].fetch_add(n, std::memory_order_relaxed);
+    }
+  }
+  m_count.fetch_add(other.count(), std::memory_order_relaxed);
+  m_sum.fetch_add(other.sum(), std::memory_order_relaxed);
+
+  uint64_t other_min = other.m_min.load(std::memory_order_relaxed);
+  uint64_t old_min = m_min.load(std::memory_order_relaxed);
+  while (other_min < old_min &&
+         !m_min.compare_exchange_weak(old_min, other_min,
+                                      std::memory_order_relaxed)) {
+  }
+  uint64_t other_max = other.max();
+  uint64_t old_max = m_max.load(std::memory_order_relaxed);
+  while (other_max > old_max &&
+         !m_max.compare_exchange_weak(old_max, other_max,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_min.store(UINT64_MAX, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::min() const {
+  uint64_t value = m_min.load(std::memory_order_relaxed);
+  return value == UINT64_MAX ? 0 : value;
+}
+
+double LatencyHistogram::mean() const {
+  uint64_t n = count();
+  return n == 0 ? 0 : static_cast<double>(sum()) / n;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+  // 并发 record 时各个计数不是同一时刻的快照，以桶的总数为准
+  uint64_t total = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    total += m_buckets[i].load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  if (percentile <= 0) {
+    return min();
+  }
+  if (percentile > 100) {
+    percentile = 100;
+  }
+  uint64_t target = static_cast<uint64_t>(percentile / 100 * total + 0.5);
+  if (target == 0) {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      // 桶上界可能超过实际最大值
+      uint64_t upper = BucketUpperBound(i);
+      return upper < max() ? upper : max();
+    }
+  }
+  return max();
+}
+
+std::string LatencyHistogram::toPercentileDistribution(
+    double value_scale /*value_scale = 1.0*/) const {
+  static const double percentiles[] = {0,    50,   75,    90,     95,
+                                       99,   99.9, 99.99, 99.999, 100};
+  std::string res = formatString("%12s %14s\n", "Value", "Percentile");
+  for (double p : percentiles) {
+    res += formatString("%12.3f %14.6f\n", percentile(p) / value_scale,
+                        p / 100);
+  }
+  res += formatString(
+      "#[Mean = %12.3f, Min = %12.3f, Max = %12.3f]\n"
+      "#[Total count = %12lu]\n",
+      mean() / value_scale, min() / value_scale, max() / value_scale,
+      count());
+  return res;
+}
+
+}  // namespace rocket
@@ -0,0 +1,74 @@
+#ifndef ROCKET_COMMON_HISTOGRAM_H
+#define ROCKET_COMMON_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace rocket {
+
+// 对数-线性分桶的延迟直方图，思路同 HdrHistogram:
+// 小于 2^(SUB_BUCKET_BITS+1) 的值每个值一个桶，
+// 更大的值按2的幂分组，每组再均分为 2^SUB_BUCKET_BITS 个桶，相对误差不超过 1/32。
+// 所有计数都是原子变量，多个线程可以同时 record，不需要加锁
+class LatencyHistogram {
+ public:
+  using s_ptr = std::shared_ptr<LatencyHistogram>;
+
+  static constexpr int SUB_BUCKET_BITS = 5;
+  static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static constexpr int MAX_VALUE_BITS = 48;  // 超过 2^48 的值记到最后一个桶
+  static constexpr size_t BUCKET_COUNT =
+      2 * SUB_BUCKET_COUNT +
+      (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT;
+
+  LatencyHistogram();
+
+  void record(uint64_t value);
+
+  // 只有一个线程写入时使用，用 load/store 代替原子的读-改-写，
+  // 其他线程仍然可以同时读取，不能和 record 混用
+  void recordSingleWriter(uint64_t value);
+
+  // 把other的计数累加到当前直方图
+  void merge(const LatencyHistogram &other);
+
+  void reset();
+
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+  uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+  uint64_t min() const;
+
+  uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+  double mean() const;
+
+  // 返回百分位数 percentile(0~100) 对应的值，取所在桶的上界
+  uint64_t percentile(double percentile) const;
+
+  // 按 HdrHistogram 的格式输出百分位分布，value_scale 用于单位换算，
+  // 例如记录的是ns、输出us时传1000
+  std::string toPercentileDistribution(double value_scale = 1.0) const;
+
+ public:
+  static size_t BucketIndex(uint64_t value);
+
+  // 桶中能放的最大值
+  static uint64_t BucketUpperBound(size_t index);
+
+ private:
+  std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_min{UINT64_MAX};
+  std::atomic<uint64_t> m_max{0};
+};
+
+}  // namespace rocket
+
+#endif
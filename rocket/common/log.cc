@@ -1,20 +1,42 @@
 #include "rocket/common/log.h"
 
-#include <sys/time.h>
+#include <unistd.h>
 
-#include <cassert>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstdio>
-#include <sstream>
+#include <cstdlib>
+#include <cstring>
 
 #include "rocket/common/config.h"
 #include "rocket/common/runtime.h"
 #include "rocket/common/util.h"
-#include "rocket/net/eventloop.h"
 
 namespace rocket {
 
 static Logger *g_logger = NULL;
 
+// 每个线程每个AsyncLogger的环形缓冲区大小
+static const size_t g_log_ring_size = 256 * 1024;
+
+// 分配AsyncLogger::m_index
+static std::atomic<int> g_async_logger_count{0};
+
+// 线程持有的环形缓冲区，线程退出时关闭，由AsyncLogger线程取完后释放
+struct ThreadLogRings {
+  ~ThreadLogRings() {
+    for (auto &ring : m_rings) {
+      if (ring) {
+        ring->close();
+      }
+    }
+  }
+  std::vector<LogRing::s_ptr> m_rings;
+};
+
+static thread_local ThreadLogRings t_log_rings;
+
 Logger::Logger(LogLevel level, int type /*type = 1*/)
     : m_set_level(level), m_type(type) {
   if (m_type == 0) {
@@ -23,47 +45,33 @@ Logger::Logger(LogLevel level, int type /*type = 1*/)
   m_async_logger = std::make_shared<AsyncLogger>(
       Config::GetGlobalConfig()->m_log_file_name + "_rpc",
       Config::GetGlobalConfig()->m_log_file_path,
-      Config::GetGlobalConfig()->m_log_max_file_size);
+      Config::GetGlobalConfig()->m_log_max_file_size,
+      Config::GetGlobalConfig()->m_log_sync_inteval,
+      Config::GetGlobalConfig()->m_log_writer);
   m_async_app_logger = std::make_shared<AsyncLogger>(
       Config::GetGlobalConfig()->m_log_file_name + "_app",
       Config::GetGlobalConfig()->m_log_file_path,
-      Config::GetGlobalConfig()->m_log_max_file_size);
+      Config::GetGlobalConfig()->m_log_max_file_size,
+      Config::GetGlobalConfig()->m_log_sync_inteval,
+      Config::GetGlobalConfig()->m_log_writer);
 }
 
-void Logger::syncLoop() {
-  // 同步m_buffer到async_logger的buffer队尾
-  std::vector<std::string> tmp_vec;
-  ScopeMutex<Mutex> lock(m_mutex);
-  tmp_vec.swap(m_buffer);
-  lock.unlock();
-
-  if (!tmp_vec.empty()) {
-    m_async_logger->pushLogBuffer(tmp_vec);
+void Logger::stop() {
+  if (m_async_logger) {
+    m_async_logger->stop();
   }
-  tmp_vec.clear();
-
-  // 同步m_app_buffer到async_logger的buffer队尾
-  std::vector<std::string> tmp_vec2;
-  ScopeMutex<Mutex> lock2(m_app_mutex);
-  tmp_vec2.swap(m_app_buffer);
-  lock2.unlock();
-
-  if (!tmp_vec2.empty()) {
-    m_async_app_logger->pushLogBuffer(tmp_vec2);
+  if (m_async_app_logger) {
+    m_async_app_logger->stop();
   }
-  tmp_vec2.clear();
 }
 
-void Logger::init() {
-  if (m_type == 0) {
-    return;
+void Logger::setMaxFileSize(int max_size) {
+  if (m_async_logger) {
+    m_async_logger->setMaxFileSize(max_size);
+  }
+  if (m_async_app_logger) {
+    m_async_app_logger->setMaxFileSize(max_size);
   }
-
-  m_timer_event = std::make_shared<TimerEvent>(
-      Config::GetGlobalConfig()->m_log_sync_inteval, true,
-      std::bind(&Logger::syncLoop, this));
-
-  EventLoop::GetCurrentEventLoop()->addTimerEvent(m_timer_event);
 }
 
 Logger *Logger::GetGlobalLogger() { return g_logger; }
@@ -74,7 +82,16 @@ void Logger::InitGlobalLogger(int type /*type = 1*/) {
   printf("Init log level [%s]\n", LogLevelToString(global_log_level).c_str());
   g_logger = new Logger(global_log_level, type);
 
-  g_logger->init();
+  // 进程正常退出时把缓冲区中剩余的日志写入文件
+  static bool g_atexit_registered = false;
+  if (!g_atexit_registered) {
+    g_atexit_registered = true;
+    atexit([]() {
+      if (g_logger) {
+        g_logger->stop();
+      }
+    });
+  }
 }
 
 std::string LogLevelToString(LogLevel level) {
@@ -104,162 +121,737 @@ LogLevel StringToLogLevel(const std::string &log_level) {
   }
 }
 
-std::string LogEvent::toString() {
-  struct timeval now_time;
-
-  gettimeofday(&now_time, nullptr);
+bool LogRateLimiter::allowEveryN(uint64_t n) {
+  if (n <= 1) {
+    return true;
+  }
+  if (m_count.fetch_add(1, std::memory_order_relaxed) % n == 0) {
+    return true;
+  }
+  m_suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
 
-  struct tm now_time_t;
-  localtime_r(&(now_time.tv_sec), &now_time_t);
+bool LogRateLimiter::allowRate(double per_sec) {
+  if (per_sec <= 0) {
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  int64_t interval = static_cast<int64_t>(1000000 / per_sec);
+  int64_t burst = static_cast<int64_t>(std::max(1.0, per_sec) * interval);
+  int64_t now = getNowUs();
+
+  int64_t next = m_next_time_us.load(std::memory_order_relaxed);
+  while (true) {
+    int64_t base = std::max(next, now);
+    if (base - now > burst - interval) {
+      // 桶中没有令牌
+      m_suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (m_next_time_us.compare_exchange_weak(next, base + interval,
+                                             std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+}
 
-  char buf[128];
-  strftime(&buf[0], 128, "%y-%m-%d %H:%M:%S", &now_time_t);
-  std::string time_str(buf);
-  int ms = now_time.tv_usec / 1000;
-  time_str = time_str + "." + std::to_string(ms);
+LogLine *LogLine::GetThreadLogLine() {
+  static thread_local LogLine t_log_line;
+  return &t_log_line;
+}
 
-  m_pid = getPid();
-  m_thread_id = getThreadId();
+void LogLine::append(const char *str, size_t len) {
+  if (len > static_cast<size_t>(MAX_LINE_SIZE - 1 - m_size)) {
+    len = MAX_LINE_SIZE - 1 - m_size;
+  }
+  memcpy(&m_data[m_size], str, len);
+  m_size += len;
+}
 
-  std::stringstream ss;
+void LogLine::appendInt(int64_t value) {
+  char buf[24];
+  int len = 0;
+  bool negative = value < 0;
+  uint64_t n = negative ? -static_cast<uint64_t>(value) : value;
+  do {
+    buf[len++] = '0' + n % 10;
+    n /= 10;
+  } while (n != 0);
+  if (negative) {
+    buf[len++] = '-';
+  }
+  std::reverse(buf, buf + len);
+  append(buf, len);
+}
 
-  ss << "[" << LogLevelToString(m_level) << "]\t"
-     << "[" << time_str << "]\t"
-     << "[" << m_pid << ":" << m_thread_id << "]\t";
+void LogLine::reset(LogLevel level, const char *file_line) {
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
 
   // 获取当前线程处理请求的msg_id
-  std::string msg_id = RunTime::GetRunTime()->m_msg_id;
-  std::string method_name = RunTime::GetRunTime()->m_method_name;
+  RequestContext *context = RequestContext::GetCurrent();
+  if (context == nullptr) {
+    reset(level, file_line, now, getThreadId(), nullptr, 0, nullptr, 0);
+    return;
+  }
+  reset(level, file_line, now, getThreadId(), context->m_msg_id.data(),
+        context->m_msg_id.size(), context->m_method_name.data(),
+        context->m_method_name.size());
+}
+
+void LogLine::reset(LogLevel level, const char *file_line, const timespec &now,
+                    pid_t thread_id, const char *msg_id, size_t msg_id_len,
+                    const char *method_name, size_t method_name_len) {
+  m_size = 0;
+  m_use_overflow = false;
+
+  append("[", 1);
+  switch (level) {
+    case Debug:
+      append("DEBUG", 5);
+      break;
+    case Info:
+      append("INFO", 4);
+      break;
+    case Error:
+      append("ERROR", 5);
+      break;
+    default:
+      append("UNKNOWN", 7);
+      break;
+  }
+  append("]\t[", 3);
+
+  // 同一秒内复用格式化好的日期时间，只拼接毫秒
+  if (now.tv_sec != m_cached_second) {
+    struct tm now_time;
+    localtime_r(&now.tv_sec, &now_time);
+    m_time_prefix_len = strftime(m_time_prefix, sizeof(m_time_prefix),
+                                 "%y-%m-%d %H:%M:%S.", &now_time);
+    m_cached_second = now.tv_sec;
+  }
+  append(m_time_prefix, m_time_prefix_len);
+  int ms = now.tv_nsec / 1000000;
+  char ms_buf[3] = {static_cast<char>('0' + ms / 100),
+                    static_cast<char>('0' + ms / 10 % 10),
+                    static_cast<char>('0' + ms % 10)};
+  append(ms_buf, 3);
+
+  append("]\t[", 3);
+  appendInt(getPid());
+  append(":", 1);
+  appendInt(thread_id);
+  append("]\t", 2);
+
+  if (msg_id_len > 0) {
+    append("[", 1);
+    append(msg_id, msg_id_len);
+    append("]", 1);
+  }
+  if (method_name_len > 0) {
+    append("[", 1);
+    append(method_name, method_name_len);
+    append("]", 1);
+  }
+
+  append("[", 1);
+  append(file_line, strlen(file_line));
+  append("]\t", 2);
+}
+
+// 二进制日志记录头，后面依次是 msg_id、method_name 和参数
+struct LogRecordHeader {
+  int32_t level;
+  pid_t thread_id;
+  timespec now;
+  const char *file_line;
+  const char *format;
+  uint16_t msg_id_len;
+  uint16_t method_name_len;
+};
+
+LogRecord *LogRecord::GetThreadLogRecord() {
+  static thread_local LogRecord t_log_record;
+  return &t_log_record;
+}
+
+void LogRecord::reset(LogLevel level, const char *file_line, const char *str) {
+  LogRecordHeader header;
+  header.level = level;
+  header.thread_id = getThreadId();
+  clock_gettime(CLOCK_REALTIME, &header.now);
+  header.file_line = file_line;
+  header.format = str;
+
+  RequestContext *context = RequestContext::GetCurrent();
+  header.msg_id_len = 0;
+  header.method_name_len = 0;
+  if (context != nullptr) {
+    header.msg_id_len = std::min<size_t>(context->m_msg_id.size(), 256);
+    header.method_name_len =
+        std::min<size_t>(context->m_method_name.size(), 256);
+  }
+
+  memcpy(m_data, &header, sizeof(header));
+  m_size = sizeof(header);
+  if (context != nullptr) {
+    memcpy(&m_data[m_size], context->m_msg_id.data(), header.msg_id_len);
+    m_size += header.msg_id_len;
+    memcpy(&m_data[m_size], context->m_method_name.data(),
+           header.method_name_len);
+    m_size += header.method_name_len;
+  }
+}
+
+bool LogRecord::encodeString(const char *value) {
+  if (value == nullptr) {
+    value = "(null)";
+  }
+  size_t len = strlen(value);
+  if (m_size + 1 + sizeof(uint32_t) + len > MAX_RECORD_SIZE) {
+    return false;
+  }
+  uint32_t size = len;
+  m_data[m_size++] = 's';
+  memcpy(&m_data[m_size], &size, sizeof(size));
+  m_size += sizeof(size);
+  memcpy(&m_data[m_size], value, len);
+  m_size += len;
+  return true;
+}
+
+// 解码过程中依次读取记录中的参数
+class LogRecordReader {
+ public:
+  LogRecordReader(const char *data, size_t len) : m_data(data), m_len(len) {}
+
+  // 读取下一个参数，没有参数时返回false
+  bool next(char &type, uint8_t &size, uint64_t &value, const char *&str,
+            uint32_t &str_len) {
+    if (m_pos >= m_len) {
+      return false;
+    }
+    type = m_data[m_pos++];
+    if (type == 's') {
+      if (m_pos + sizeof(str_len) > m_len) {
+        return false;
+      }
+      memcpy(&str_len, &m_data[m_pos], sizeof(str_len));
+      m_pos += sizeof(str_len);
+      if (m_pos + str_len > m_len) {
+        return false;
+      }
+      str = &m_data[m_pos];
+      m_pos += str_len;
+      return true;
+    }
+    if (m_pos + 1 + sizeof(value) > m_len) {
+      return false;
+    }
+    size = static_cast<uint8_t>(m_data[m_pos++]);
+    memcpy(&value, &m_data[m_pos], sizeof(value));
+    m_pos += sizeof(value);
+    return true;
+  }
+
+ private:
+  const char *m_data{nullptr};
+  size_t m_len{0};
+  size_t m_pos{0};
+};
+
+// 按一个转换说明格式化一个参数，spec 为去掉长度修饰符的 "%...", conversion 为转换字符
+static void formatArg(std::string &out, std::string spec, char conversion,
+                      LogRecordReader &reader) {
+  char type = 0;
+  uint8_t size = 0;
+  uint64_t value = 0;
+  const char *str = nullptr;
+  uint32_t str_len = 0;
+  if (!reader.next(type, size, value, str, str_len)) {
+    out.append("<missing>");
+    return;
+  }
+
+  char buf[512];
+  int len = -1;
+  switch (conversion) {
+    case 'd':
+    case 'i': {
+      if (type == 's' || type == 'f') {
+        break;
+      }
+      spec += "lld";
+      len = snprintf(buf, sizeof(buf), spec.c_str(),
+                     static_cast<long long>(value));
+      break;
+    }
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X': {
+      if (type == 's' || type == 'f') {
+        break;
+      }
+      // 有符号数按原始宽度截断，与直接用 printf 输出的结果一致
+      if (type == 'i' && size < sizeof(value)) {
+        value &= (1ULL << (size * 8)) - 1;
+      }
+      spec += "ll";
+      spec += conversion;
+      len = snprintf(buf, sizeof(buf), spec.c_str(),
+                     static_cast<unsigned long long>(value));
+      break;
+    }
+    case 'c': {
+      if (type == 's' || type == 'f') {
+        break;
+      }
+      spec += 'c';
+      len = snprintf(buf, sizeof(buf), spec.c_str(), static_cast<int>(value));
+      break;
+    }
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      if (type != 'f') {
+        break;
+      }
+      double d = 0;
+      memcpy(&d, &value, sizeof(d));
+      spec += conversion;
+      len = snprintf(buf, sizeof(buf), spec.c_str(), d);
+      break;
+    }
+    case 's': {
+      if (type != 's') {
+        break;
+      }
+      // 没有宽度和精度时直接追加，避免字符串被截断
+      if (spec == "%") {
+        out.append(str, str_len);
+        return;
+      }
+      std::string tmp(str, str_len);
+      spec += 's';
+      len = snprintf(buf, sizeof(buf), spec.c_str(), tmp.c_str());
+      break;
+    }
+    case 'p': {
+      if (type == 's' || type == 'f') {
+        break;
+      }
+      spec += 'p';
+      len = snprintf(buf, sizeof(buf), spec.c_str(),
+                     reinterpret_cast<void *>(value));
+      break;
+    }
+    default:
+      break;
+  }
+
+  if (len < 0) {
+    out.append("<bad arg>");
+    return;
+  }
+  out.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
 
-  if (!msg_id.empty()) {
-    ss << "[" << msg_id << "]";
+void LogRecord::Decode(const char *data, size_t len, std::string &out) {
+  LogRecordHeader header;
+  if (len < sizeof(header)) {
+    return;
   }
+  memcpy(&header, data, sizeof(header));
+  size_t pos = sizeof(header);
+  if (pos + header.msg_id_len + header.method_name_len > len) {
+    return;
+  }
+  const char *msg_id = &data[pos];
+  pos += header.msg_id_len;
+  const char *method_name = &data[pos];
+  pos += header.method_name_len;
+
+  LogRecordReader reader(&data[pos], len - pos);
+
+  // 逐个解析格式串中的转换说明
+  std::string msg;
+  const char *p = header.format;
+  while (*p != '\0') {
+    if (*p != '%') {
+      const char *begin = p;
+      while (*p != '\0' && *p != '%') {
+        ++p;
+      }
+      msg.append(begin, p - begin);
+      continue;
+    }
+    if (p[1] == '%') {
+      msg.push_back('%');
+      p += 2;
+      continue;
+    }
 
-  if (!method_name.empty()) {
-    ss << "[" << method_name << "]";
+    std::string spec = "%";
+    ++p;
+    // 标志
+    while (*p != '\0' && strchr("-+ #0", *p) != nullptr) {
+      spec.push_back(*p++);
+    }
+    // 宽度和精度，'*' 从参数中读取
+    while (*p != '\0' && (isdigit(*p) || *p == '.' || *p == '*')) {
+      if (*p == '*') {
+        char type = 0;
+        uint8_t size = 0;
+        uint64_t value = 0;
+        const char *str = nullptr;
+        uint32_t str_len = 0;
+        reader.next(type, size, value, str, str_len);
+        spec += std::to_string(static_cast<int>(value));
+        ++p;
+        continue;
+      }
+      spec.push_back(*p++);
+    }
+    // 长度修饰符由参数的实际类型决定，这里直接跳过
+    while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) {
+      ++p;
+    }
+    if (*p == '\0') {
+      break;
+    }
+    char conversion = *p++;
+    if (conversion == 'n') {
+      continue;
+    }
+    formatArg(msg, spec, conversion, reader);
   }
 
-  return ss.str();
+  LogLine *line = LogLine::GetThreadLogLine();
+  line->reset(static_cast<LogLevel>(header.level), header.file_line,
+              header.now, header.thread_id, msg_id, header.msg_id_len,
+              method_name, header.method_name_len);
+  line->format("%s", msg.c_str());
+  out.append(line->data(), line->size());
 }
 
 void Logger::pushLog(const std::string &msg) {
+  pushLog(msg.data(), msg.size());
+}
+
+void Logger::pushLog(const char *data, size_t len) {
+  // 同步日志直接打印到终端
   if (m_type == 0) {
-    printf(msg.c_str());
+    fwrite(data, 1, len, stdout);
+    return;
   }
-  ScopeMutex<Mutex> lock(m_mutex);
-  m_buffer.push_back(msg);
-  lock.unlock();
+  pushToAsyncLogger(m_async_logger.get(), data, len);
 }
 
 void Logger::pushAppLog(const std::string &msg) {
-  ScopeMutex<Mutex> lock(m_app_mutex);
-  m_app_buffer.push_back(msg);
-  lock.unlock();
+  pushAppLog(msg.data(), msg.size());
+}
+
+void Logger::pushAppLog(const char *data, size_t len) {
+  if (m_type == 0) {
+    fwrite(data, 1, len, stdout);
+    return;
+  }
+  pushToAsyncLogger(m_async_app_logger.get(), data, len);
+}
+
+void Logger::pushToAsyncLogger(AsyncLogger *logger, const char *data,
+                               size_t len, bool binary /*binary = false*/) {
+  LogRing *ring = logger->getThreadLogRing();
+  if (ring->push(data, len, binary)) {
+    // 缓冲区已过半时唤醒异步线程，否则等它定时来取
+    if (ring->needNotify()) {
+      logger->notify();
+    }
+    return;
+  }
+
+  if (m_full_policy.load(std::memory_order_relaxed) == LogBlockOnFull &&
+      ring->canHold(len)) {
+    // 等待异步日志线程取走日志
+    while (!logger->isStopped()) {
+      logger->notify();
+      usleep(100);
+      if (ring->push(data, len, binary)) {
+        return;
+      }
+    }
+  }
+  ring->addDropCount();
+  m_drop_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+LogRing::LogRing(size_t size) {
+  size_t capacity = 1;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  m_buffer.resize(capacity);
+  m_mask = capacity - 1;
+}
+
+void LogRing::copyIn(uint64_t index, const char *data, size_t len) {
+  size_t pos = index & m_mask;
+  size_t first = std::min(len, m_buffer.size() - pos);
+  memcpy(&m_buffer[pos], data, first);
+  memcpy(&m_buffer[0], data + first, len - first);
 }
 
-void Logger::log() {}
+void LogRing::copyOut(uint64_t index, char *data, size_t len) const {
+  size_t pos = index & m_mask;
+  size_t first = std::min(len, m_buffer.size() - pos);
+  memcpy(data, &m_buffer[pos], first);
+  memcpy(data + first, &m_buffer[0], len - first);
+}
+
+bool LogRing::push(const char *data, size_t len,
+                   bool binary /*binary = false*/) {
+  uint64_t write_index = m_write_index.load(std::memory_order_relaxed);
+  uint64_t read_index = m_read_index.load(std::memory_order_acquire);
+  size_t need = sizeof(uint32_t) + len;
+  if (need > m_buffer.size() - (write_index - read_index)) {
+    return false;
+  }
+
+  uint32_t size = binary ? (len | BINARY_FLAG) : len;
+  copyIn(write_index, reinterpret_cast<const char *>(&size), sizeof(size));
+  copyIn(write_index + sizeof(size), data, len);
+  m_write_index.store(write_index + need, std::memory_order_release);
+  return true;
+}
+
+size_t LogRing::drain(std::string &out) {
+  uint64_t read_index = m_read_index.load(std::memory_order_relaxed);
+  uint64_t write_index = m_write_index.load(std::memory_order_acquire);
+  size_t old_size = out.size();
+
+  std::vector<char> record;
+  while (read_index < write_index) {
+    uint32_t size = 0;
+    copyOut(read_index, reinterpret_cast<char *>(&size), sizeof(size));
+    bool binary = (size & BINARY_FLAG) != 0;
+    size &= ~BINARY_FLAG;
+    if (binary) {
+      record.resize(size);
+      copyOut(read_index + sizeof(size), record.data(), size);
+      LogRecord::Decode(record.data(), size, out);
+    } else {
+      size_t pos = out.size();
+      out.resize(pos + size);
+      copyOut(read_index + sizeof(size), &out[pos], size);
+    }
+    read_index += sizeof(size) + size;
+  }
+  m_read_index.store(read_index, std::memory_order_release);
+  m_notified.store(false, std::memory_order_relaxed);
+
+  return out.size() - old_size;
+}
+
+bool LogRing::needNotify() {
+  uint64_t used = m_write_index.load(std::memory_order_relaxed) -
+                  m_read_index.load(std::memory_order_relaxed);
+  if (used <= m_buffer.size() / 2 ||
+      m_notified.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  return !m_notified.exchange(true, std::memory_order_relaxed);
+}
 
 AsyncLogger::AsyncLogger(const std::string &file_name,
-                         const std::string &file_path, int max_size)
-    : m_file_name(file_name),
+                         const std::string &file_path, int max_size,
+                         int sync_interval,
+                         const std::string &writer_type /*writer_type = ""*/)
+    : m_index(g_async_logger_count.fetch_add(1)),
+      m_file_name(file_name),
       m_file_path(file_path),
-      m_max_file_size(max_size) {
-  // 初始化信号量,创建线程和初始化条件变量
+      m_max_file_size(max_size),
+      m_sync_interval(sync_interval > 0 ? sync_interval : 500) {
+  // 初始化信号量和条件变量，再创建线程
+  m_writer = LogFileWriter::Create(writer_type);
+  m_staging.reserve(2 * FLUSH_SIZE);
   sem_init(&m_semphore, 0, 0);
-  assert(pthread_create(&m_pthread, nullptr, &AsyncLogger::Loop, this) == 0);
-  assert(pthread_cond_init(&m_condition_variable, nullptr) == 0);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  // 日志线程起不来时后面的 sem_wait 会一直阻塞，失败时直接退出
+  int rt = pthread_cond_init(&m_condition_variable, &attr);
+  pthread_condattr_destroy(&attr);
+  if (rt != 0) {
+    printf("AsyncLogger init condition variable error, rt=%d\n", rt);
+    abort();
+  }
+  rt = pthread_create(&m_pthread, nullptr, &AsyncLogger::Loop, this);
+  if (rt != 0) {
+    printf("AsyncLogger create thread error, rt=%d\n", rt);
+    abort();
+  }
 
   sem_wait(&m_semphore);
 }
 
+AsyncLogger::~AsyncLogger() {
+  stop();
+  pthread_cond_destroy(&m_condition_variable);
+  sem_destroy(&m_semphore);
+}
+
+LogRing *AsyncLogger::getThreadLogRing() {
+  std::vector<LogRing::s_ptr> &rings = t_log_rings.m_rings;
+  if (static_cast<int>(rings.size()) <= m_index) {
+    rings.resize(m_index + 1);
+  }
+  if (!rings[m_index]) {
+    rings[m_index] = std::make_shared<LogRing>(g_log_ring_size);
+    ScopeMutex<Mutex> lock(m_mutex);
+    m_rings.push_back(rings[m_index]);
+  }
+  return rings[m_index].get();
+}
+
+void AsyncLogger::notify() { pthread_cond_signal(&m_condition_variable); }
+
+void AsyncLogger::drainRings(std::string &out) {
+  ScopeMutex<Mutex> lock(m_mutex);
+  uint64_t drop_count = 0;
+  for (auto it = m_rings.begin(); it != m_rings.end();) {
+    // 先判断是否关闭再取日志，保证关闭前写入的日志都被取走
+    bool closed = (*it)->isClosed();
+    (*it)->drain(out);
+    drop_count += (*it)->takeDropCount();
+    if (closed) {
+      it = m_rings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  lock.unlock();
+
+  if (drop_count > 0) {
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf),
+                       "[ERROR]\tlog buffer full, drop %lu log lines\n",
+                       static_cast<unsigned long>(drop_count));
+    out.append(buf, len);
+  }
+}
+
 void *AsyncLogger::Loop(void *arg) {
-  // 将buffer中的全部数据都打印到文件中，线程睡眠，直到有新的数据到来，重复这个过程
+  // 定时或者被唤醒后取出所有线程缓冲区中的日志，攒够 FLUSH_SIZE
+  // 或者距离上次写文件超过 sync_interval 时一次写入文件
 
   AsyncLogger *logger = reinterpret_cast<AsyncLogger *>(arg);
   sem_post(&logger->m_semphore);
 
+  int64_t last_write_ms = getNowUs() / 1000;
   while (1) {
     ScopeMutex<Mutex> lock(logger->m_mutex);
-    while (logger->m_buffer.empty()) {
-      pthread_cond_wait(&(logger->m_condition_variable),
-                        logger->m_mutex.getMutex());
+    if (!logger->isStopped() && !logger->m_flush_request.load()) {
+      timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      int64_t nsec = deadline.tv_nsec + logger->m_sync_interval * 1000000L;
+      deadline.tv_sec += nsec / 1000000000L;
+      deadline.tv_nsec = nsec % 1000000000L;
+      pthread_cond_timedwait(&(logger->m_condition_variable),
+                             logger->m_mutex.getMutex(), &deadline);
     }
-
-    std::vector<std::string> tmp;
-    tmp.swap(logger->m_buffer.front());
-    logger->m_buffer.pop();
-
     lock.unlock();
+    bool stop = logger->isStopped();
+    bool flush = logger->m_flush_request.exchange(false);
 
-    timeval now;
-    gettimeofday(&now, nullptr);
-
-    struct tm now_time;
-    localtime_r(&now.tv_sec, &now_time);
-
-    const char *format = "%Y%m%d";
-    char date[32];
-    strftime(date, sizeof(date), format, &now_time);
+    logger->drainRings(logger->m_staging);
 
-    if (std::string(date) != logger->m_date) {
-      logger->m_log_num = 0;
-      logger->m_reopen_flag = true;
-      logger->m_date = std::string(date);
-    }
-    if (logger->m_file_handler == nullptr) {
-      logger->m_reopen_flag = true;
-    }
-    std::stringstream ss;
-    ss << logger->m_file_path << logger->m_file_name << "_" << std::string(date)
-       << "_log.";
-    std::string log_file_name = ss.str() + std::to_string(logger->m_log_num);
-
-    if (logger->m_reopen_flag) {
-      if (logger->m_file_handler) {
-        fclose(logger->m_file_handler);
+    int64_t now_ms = getNowUs() / 1000;
+    if (stop || flush || logger->m_staging.size() >= FLUSH_SIZE ||
+        now_ms - last_write_ms >= logger->m_sync_interval) {
+      if (!logger->m_staging.empty()) {
+        logger->writeToFile(logger->m_staging);
+        logger->m_staging.clear();
       }
-      logger->m_file_handler = fopen(log_file_name.c_str(), "a");
-      logger->m_reopen_flag = false;
+      last_write_ms = now_ms;
     }
 
-    // 判断文件大小是否超出最大值
-    if (ftell(logger->m_file_handler) > logger->m_max_file_size) {
-      fclose(logger->m_file_handler);
-      log_file_name = ss.str() + std::to_string(++logger->m_log_num);
-
-      logger->m_file_handler = fopen(log_file_name.c_str(), "a");
-      logger->m_reopen_flag = false;
+    if (stop) {
+      logger->m_writer->close();
+      return nullptr;
     }
+  }
+  return nullptr;
+}
+
+bool AsyncLogger::openLogFile() {
+  time_t now = time(nullptr);
+  if (now >= m_date_expire) {
+    struct tm now_time;
+    localtime_r(&now, &now_time);
 
-    for (auto &e : tmp) {
-      fwrite(e.c_str(), 1, e.size(), logger->m_file_handler);
+    char date[32];
+    strftime(date, sizeof(date), "%Y%m%d", &now_time);
+
+    // 下一天零点日期才会变化
+    now_time.tm_hour = 0;
+    now_time.tm_min = 0;
+    now_time.tm_sec = 0;
+    now_time.tm_mday += 1;
+    now_time.tm_isdst = -1;
+    m_date_expire = mktime(&now_time);
+
+    if (m_date != date) {
+      m_date = date;
+      m_log_num = 0;
+      m_writer->close();
     }
+  }
 
-    // 刷新到磁盘
-    fflush(logger->m_file_handler);
+  // 判断文件大小是否超出最大值
+  if (m_writer->isOpen() &&
+      m_writer->size() > m_max_file_size.load(std::memory_order_relaxed)) {
+    m_writer->close();
+    ++m_log_num;
+  }
 
-    if (logger->m_stop_flag) {
-      return nullptr;
-    }
+  if (!m_writer->isOpen()) {
+    std::string log_file_name = m_file_path + m_file_name + "_" + m_date +
+                                "_log." + std::to_string(m_log_num);
+    return m_writer->open(log_file_name);
   }
-  return nullptr;
+  return true;
 }
 
-void AsyncLogger::stop() { m_stop_flag = true; }
-
-void AsyncLogger::flush() {
-  if (m_file_handler) {
-    fflush(m_file_handler);
+void AsyncLogger::writeToFile(const std::string &data) {
+  if (!openLogFile()) {
+    return;
   }
+  m_writer->write(data.data(), data.size());
 }
 
-void AsyncLogger::pushLogBuffer(std::vector<std::string> &vec) {
+void AsyncLogger::stop() {
   ScopeMutex<Mutex> lock(m_mutex);
-  m_buffer.push(vec);
+  if (m_stopped) {
+    return;
+  }
+  m_stopped = true;
+  m_stop_flag.store(true, std::memory_order_release);
   lock.unlock();
 
-  // 此时唤醒异步日志线程
   pthread_cond_signal(&m_condition_variable);
+  pthread_join(m_pthread, nullptr);
+}
+
+void AsyncLogger::flush() {
+  m_flush_request.store(true);
+  notify();
 }
 
-}  // namespace rocket
\ No newline at end of file
+}  // namespace rocket
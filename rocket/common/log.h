@@ -2,14 +2,21 @@
 #define ROCKET_COMMON_LOG_H
 
 #include <semaphore.h>
+#include <sys/types.h>
+#include <time.h>
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <memory>
-#include <queue>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "rocket/common/config.h"
+#include "rocket/common/log_file_writer.h"
 #include "rocket/common/mutex.h"
-#include "rocket/net/timer_event.h"
 
 namespace rocket {
 
@@ -26,99 +33,416 @@ std::string formatString(const char *str, Args &&... args) {
   return result;
 }
 
-#define DEBUGLOG(str, ...)                                                 \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Debug) { \
-    rocket::Logger::GetGlobalLogger()->pushLog(                            \
-        rocket::LogEvent(rocket::LogLevel::Debug).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +   \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                  \
+// 编译期最低日志级别: 1 DEBUG, 2 INFO, 3 ERROR
+// 低于这个级别的日志调用在编译期就被去掉，参数也不会被求值，
+// 例如 -DROCKET_MIN_LOG_LEVEL=2 去掉所有 DEBUG 日志
+#ifndef ROCKET_MIN_LOG_LEVEL
+#define ROCKET_MIN_LOG_LEVEL 1
+#endif
+
+#define ROCKET_LOG_STR(x) #x
+#define ROCKET_LOG_LINE_STR(x) ROCKET_LOG_STR(x)
+// "file:line" 在编译期拼接成字符串常量
+#define ROCKET_LOG_FILE_LINE __FILE__ ":" ROCKET_LOG_LINE_STR(__LINE__)
+
+#define DEBUGLOG(str, ...)                                                    \
+  if (ROCKET_MIN_LOG_LEVEL <= 1 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Debug) {    \
+    rocket::Logger::GetGlobalLogger()->log(                                   \
+        rocket::LogLevel::Debug, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);   \
   }
 
-#define INFOLOG(str, ...)                                                 \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Info) { \
-    rocket::Logger::GetGlobalLogger()->pushLog(                           \
-        rocket::LogEvent(rocket::LogLevel::Info).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +  \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                 \
+#define INFOLOG(str, ...)                                                     \
+  if (ROCKET_MIN_LOG_LEVEL <= 2 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Info) {     \
+    rocket::Logger::GetGlobalLogger()->log(                                   \
+        rocket::LogLevel::Info, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);    \
   }
 
-#define ERRORLOG(str, ...)                                                 \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Error) { \
-    rocket::Logger::GetGlobalLogger()->pushLog(                            \
-        rocket::LogEvent(rocket::LogLevel::Error).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +   \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                  \
+#define ERRORLOG(str, ...)                                                    \
+  if (ROCKET_MIN_LOG_LEVEL <= 3 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Error) {    \
+    rocket::Logger::GetGlobalLogger()->log(                                   \
+        rocket::LogLevel::Error, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);   \
   }
 
-#define APPDEBUGLOG(str, ...)                                              \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Debug) { \
-    rocket::Logger::GetGlobalLogger()->pushAppLog(                         \
-        rocket::LogEvent(rocket::LogLevel::Debug).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +   \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                  \
+#define APPDEBUGLOG(str, ...)                                                 \
+  if (ROCKET_MIN_LOG_LEVEL <= 1 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Debug) {    \
+    rocket::Logger::GetGlobalLogger()->appLog(                                \
+        rocket::LogLevel::Debug, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);   \
   }
 
-#define APPINFOLOG(str, ...)                                              \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Info) { \
-    rocket::Logger::GetGlobalLogger()->pushAPPLog(                        \
-        rocket::LogEvent(rocket::LogLevel::Info).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +  \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                 \
+#define APPINFOLOG(str, ...)                                                  \
+  if (ROCKET_MIN_LOG_LEVEL <= 2 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Info) {     \
+    rocket::Logger::GetGlobalLogger()->appLog(                                \
+        rocket::LogLevel::Info, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);    \
   }
 
-#define APPERRORLOG(str, ...)                                              \
-  if (rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Error) { \
-    rocket::Logger::GetGlobalLogger()->pushAPPLog(                         \
-        rocket::LogEvent(rocket::LogLevel::Error).toString() + "[" +       \
-        std::string(__FILE__) + ":" + std::to_string(__LINE__) + "]\t" +   \
-        rocket::formatString(str, ##__VA_ARGS__) + "\n");                  \
+#define APPERRORLOG(str, ...)                                                 \
+  if (ROCKET_MIN_LOG_LEVEL <= 3 &&                                            \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::Error) {    \
+    rocket::Logger::GetGlobalLogger()->appLog(                                \
+        rocket::LogLevel::Error, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__);   \
   }
 
+// 每个请求都会打印的日志，每个调用点每秒最多打印的条数
+#ifndef ROCKET_REQUEST_LOG_RATE
+#define ROCKET_REQUEST_LOG_RATE 100
+#endif
+
+// 按调用点限流的日志，每个调用点有一个静态的 LogRateLimiter，
+// 被限流的条数在下一次打印前以一行汇总日志输出
+#define ROCKET_LIMITED_LOG(level, level_num, func, check, str, ...)          \
+  if (ROCKET_MIN_LOG_LEVEL <= level_num &&                                    \
+      rocket::Logger::GetGlobalLogger()->getLogLevel() <= rocket::level) {    \
+    static rocket::LogRateLimiter rocket_log_limiter;                         \
+    if (rocket_log_limiter.check) {                                           \
+      uint64_t rocket_log_suppressed = rocket_log_limiter.takeSuppressed();   \
+      if (rocket_log_suppressed > 0) {                                        \
+        rocket::Logger::GetGlobalLogger()->func(                              \
+            rocket::LogLevel::level, ROCKET_LOG_FILE_LINE,                    \
+            "suppressed %lu log lines from this call site",                   \
+            static_cast<unsigned long>(rocket_log_suppressed));               \
+      }                                                                       \
+      rocket::Logger::GetGlobalLogger()->func(                                \
+          rocket::LogLevel::level, ROCKET_LOG_FILE_LINE, str, ##__VA_ARGS__); \
+    }                                                                         \
+  }
+
+// 每 n 次调用打印一次
+#define DEBUGLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Debug, 1, log, allowEveryN(n), str, ##__VA_ARGS__)
+#define INFOLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Info, 2, log, allowEveryN(n), str, ##__VA_ARGS__)
+#define ERRORLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Error, 3, log, allowEveryN(n), str, ##__VA_ARGS__)
+#define APPDEBUGLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Debug, 1, appLog, allowEveryN(n), str, ##__VA_ARGS__)
+#define APPINFOLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Info, 2, appLog, allowEveryN(n), str, ##__VA_ARGS__)
+#define APPERRORLOG_EVERY_N(n, str, ...) \
+  ROCKET_LIMITED_LOG(Error, 3, appLog, allowEveryN(n), str, ##__VA_ARGS__)
+
+// 令牌桶限流，每秒最多打印 per_sec 条，允许 per_sec 条的突发
+#define DEBUGLOG_RATE(per_sec, str, ...) \
+  ROCKET_LIMITED_LOG(Debug, 1, log, allowRate(per_sec), str, ##__VA_ARGS__)
+#define INFOLOG_RATE(per_sec, str, ...) \
+  ROCKET_LIMITED_LOG(Info, 2, log, allowRate(per_sec), str, ##__VA_ARGS__)
+#define ERRORLOG_RATE(per_sec, str, ...) \
+  ROCKET_LIMITED_LOG(Error, 3, log, allowRate(per_sec), str, ##__VA_ARGS__)
+#define APPDEBUGLOG_RATE(per_sec, str, ...)                     \
+  ROCKET_LIMITED_LOG(Debug, 1, appLog, allowRate(per_sec), str, \
+                     ##__VA_ARGS__)
+#define APPINFOLOG_RATE(per_sec, str, ...) \
+  ROCKET_LIMITED_LOG(Info, 2, appLog, allowRate(per_sec), str, ##__VA_ARGS__)
+#define APPERRORLOG_RATE(per_sec, str, ...)                     \
+  ROCKET_LIMITED_LOG(Error, 3, appLog, allowRate(per_sec), str, \
+                     ##__VA_ARGS__)
+
+enum LogLevel { Unknown = 0, Debug = 1, Info = 2, Error = 3 };
+
+std::string LogLevelToString(LogLevel level);
+
+LogLevel StringToLogLevel(const std::string &log_level);
+
+// 单个日志调用点的采样和限流状态，多线程共享，不加锁
+class LogRateLimiter {
+ public:
+  // 第 1, n+1, 2n+1 ... 次调用返回true
+  bool allowEveryN(uint64_t n);
+
+  // 令牌桶，每秒产生 per_sec 个令牌，桶容量也是 per_sec
+  bool allowRate(double per_sec);
+
+  // 返回并清零上次允许打印之后被限流的条数
+  uint64_t takeSuppressed() {
+    return m_suppressed.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_suppressed{0};
+
+  // 令牌桶用 GCRA 实现: m_next_time_us 为令牌桶恰好补满的理论时间，
+  // 它不超过 now + 桶容量对应的时长时允许打印
+  std::atomic<int64_t> m_next_time_us{0};
+};
+
+// 线程局部的日志行缓冲区，格式化一行日志不需要申请内存
+// 时间戳按秒缓存，进程号和线程号只获取一次
+class LogLine {
+ public:
+  static constexpr int MAX_LINE_SIZE = 4096;
+
+  static LogLine *GetThreadLogLine();
+
+  // 清空缓冲区并写入日志头: [级别] [时间] [pid:tid] [msg_id][method] [file:line]
+  void reset(LogLevel level, const char *file_line);
+
+  // 使用记录中保存的时间、线程号和请求信息写入日志头，用于格式化二进制日志
+  void reset(LogLevel level, const char *file_line, const timespec &now,
+             pid_t thread_id, const char *msg_id, size_t msg_id_len,
+             const char *method_name, size_t method_name_len);
+
+  // 追加格式化后的日志内容和换行符，超出MAX_LINE_SIZE时改用m_overflow
+  template <typename... Args>
+  void format(const char *str, Args &&... args) {
+    int avail = MAX_LINE_SIZE - m_size - 1;  // 留一个字节给换行符
+    int size = snprintf(&m_data[m_size], avail + 1, str, args...);
+    if (size < 0) {
+      size = 0;
+    }
+    if (size <= avail) {
+      m_size += size;
+      m_data[m_size++] = '\n';
+      m_use_overflow = false;
+      return;
+    }
+    m_overflow.assign(m_data, m_size);
+    m_overflow.resize(m_size + size);
+    snprintf(&m_overflow[m_size], size + 1, str, args...);
+    m_overflow.push_back('\n');
+    m_use_overflow = true;
+  }
+
+  const char *data() const {
+    return m_use_overflow ? m_overflow.data() : m_data;
+  }
+
+  size_t size() const {
+    return m_use_overflow ? m_overflow.size() : m_size;
+  }
+
+ private:
+  void append(const char *str, size_t len);
+
+  void appendInt(int64_t value);
+
+ private:
+  char m_data[MAX_LINE_SIZE];
+  int m_size{0};
+
+  std::string m_overflow;  // 超长日志使用的缓冲区
+  bool m_use_overflow{false};
+
+  time_t m_cached_second{-1};  // m_time_prefix 对应的秒数
+  char m_time_prefix[32];      // 缓存的 "yy-mm-dd HH:MM:SS."
+  int m_time_prefix_len{0};
+};
+
+// 二进制日志记录，写日志的线程只保存格式串指针和原始参数，
+// 由AsyncLogger线程调用Decode格式化成文本
+// 格式串和 file:line 都是字符串常量，进程内可以直接用指针作为id
+class LogRecord {
+ public:
+  static constexpr int MAX_RECORD_SIZE = 4096;
+
+  static LogRecord *GetThreadLogRecord();
+
+  // 清空缓冲区并写入记录头
+  void reset(LogLevel level, const char *file_line, const char *str);
+
+  // 依次写入参数，超出MAX_RECORD_SIZE时返回false
+  template <typename... Args>
+  bool encode(Args &&... args) {
+    return (encodeArg(args) && ...);
+  }
+
+  const char *data() const { return m_data; }
+
+  size_t size() const { return m_size; }
+
+  // 把一条二进制记录格式化成一行文本追加到 out 中
+  static void Decode(const char *data, size_t len, std::string &out);
+
+ private:
+  template <typename T>
+  bool encodeArg(const T &value) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, const char *> ||
+                  std::is_same_v<U, char *>) {
+      return encodeString(value);
+    } else if constexpr (std::is_floating_point_v<U>) {
+      return encodeValue('f', sizeof(U), static_cast<double>(value));
+    } else if constexpr (std::is_enum_v<U>) {
+      return encodeValue('i', sizeof(U), static_cast<int64_t>(value));
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+      return encodeValue('i', sizeof(U), static_cast<int64_t>(value));
+    } else if constexpr (std::is_integral_v<U>) {
+      return encodeValue('u', sizeof(U), static_cast<uint64_t>(value));
+    } else if constexpr (std::is_pointer_v<U>) {
+      return encodeValue('p', sizeof(U), reinterpret_cast<uint64_t>(value));
+    } else {
+      static_assert(sizeof(U) == 0, "unsupported log argument type");
+      return false;
+    }
+  }
+
+  // 参数格式: 1字节类型 + 1字节原始大小 + 8字节值
+  template <typename V>
+  bool encodeValue(char type, uint8_t size, V value) {
+    if (m_size + 2 + sizeof(V) > MAX_RECORD_SIZE) {
+      return false;
+    }
+    m_data[m_size++] = type;
+    m_data[m_size++] = static_cast<char>(size);
+    memcpy(&m_data[m_size], &value, sizeof(V));
+    m_size += sizeof(V);
+    return true;
+  }
+
+  // 字符串参数格式: 1字节类型 + 4字节长度 + 内容
+  bool encodeString(const char *value);
+
+ private:
+  char m_data[MAX_RECORD_SIZE];
+  size_t m_size{0};
+};
+
+// 单生产者单消费者的日志环形缓冲区
+// 每个线程对每个AsyncLogger各有一个，生产者是写日志的线程，消费者是AsyncLogger线程，
+// 读写位置都是原子变量，写日志时不需要加锁。每条记录为 4 字节长度 + 日志内容，
+// 长度的最高位表示内容是二进制日志记录
+class LogRing {
+ public:
+  using s_ptr = std::shared_ptr<LogRing>;
+
+  static constexpr uint32_t BINARY_FLAG = 1u << 31;
+
+  // size 会向上取整为 2 的幂
+  explicit LogRing(size_t size);
+
+  // 生产者调用，空间不足时返回false
+  bool push(const char *data, size_t len, bool binary = false);
+
+  // 记录一条因空间不足被丢弃的日志
+  void addDropCount() { m_drop_count.fetch_add(1, std::memory_order_relaxed); }
+
+  // 缓冲区能否容纳一条长度为 len 的日志
+  bool canHold(size_t len) const {
+    return sizeof(uint32_t) + len <= m_buffer.size();
+  }
+
+  // 消费者调用，把当前所有日志追加到 out 中，二进制记录在这里格式化，返回取出的字节数
+  size_t drain(std::string &out);
+
+  // 已使用的字节数超过一半且本轮还没有通知过消费者时返回true
+  bool needNotify();
+
+  // 生产者线程退出时调用，消费者取完剩余日志后释放
+  void close() { m_closed.store(true, std::memory_order_release); }
+
+  bool isClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+  bool isEmpty() const {
+    return m_write_index.load(std::memory_order_acquire) ==
+           m_read_index.load(std::memory_order_relaxed);
+  }
+
+  // 返回并清零丢弃的日志条数
+  uint64_t takeDropCount() {
+    return m_drop_count.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  void copyIn(uint64_t index, const char *data, size_t len);
+
+  void copyOut(uint64_t index, char *data, size_t len) const;
+
+ private:
+  std::vector<char> m_buffer;
+  uint64_t m_mask{0};
+
+  // 读写位置只增不减，取模后才是缓冲区下标；分开放在不同的缓存行避免伪共享
+  alignas(64) std::atomic<uint64_t> m_write_index{0};
+  alignas(64) std::atomic<uint64_t> m_read_index{0};
+
+  std::atomic<uint64_t> m_drop_count{0};
+  std::atomic<bool> m_notified{false};  // 消费者取日志后清除
+  std::atomic<bool> m_closed{false};
+};
+
+// 线程日志缓冲区写满时的处理策略
+enum LogFullPolicy {
+  LogDropOnFull = 0,   // 丢弃这条日志并计数
+  LogBlockOnFull = 1,  // 唤醒异步日志线程并等待缓冲区有空间
+};
+
 class AsyncLogger {
  public:
   using s_ptr = std::shared_ptr<AsyncLogger>;
 
+  // 待写入数据超过这个大小时立即写文件，否则最多攒 sync_interval 毫秒
+  static constexpr size_t FLUSH_SIZE = 1024 * 1024;
+
+  // writer_type 为 "mmap" 时使用内存映射方式写文件，见 LogFileWriter::Create
   AsyncLogger(const std::string &file_name, const std::string &file_path,
-              int max_size);
+              int max_size, int sync_interval,
+              const std::string &writer_type = "");
+
+  ~AsyncLogger();
 
+  // 取完所有环形缓冲区中的日志后退出线程
   void stop();
 
-  // 刷盘
+  // 通知异步日志线程立即把已取出的日志写入文件
   void flush();
 
-  void pushLogBuffer(std::vector<std::string> &vec);
+  bool isStopped() const { return m_stop_flag.load(std::memory_order_acquire); }
+
+  // 获取当前线程写入这个AsyncLogger的环形缓冲区，首次调用时创建并注册
+  LogRing *getThreadLogRing();
+
+  // 唤醒异步日志线程立即取日志
+  void notify();
+
+  // 修改单个日志文件的最大大小，下次检查文件时生效
+  void setMaxFileSize(int max_size) {
+    m_max_file_size.store(max_size, std::memory_order_relaxed);
+  }
 
  public:
   static void *Loop(void *);
 
  private:
-  std::queue<std::vector<std::string>> m_buffer;
+  // 从所有环形缓冲区取日志，移除已关闭且取空的缓冲区
+  void drainRings(std::string &out);
+
+  // 按日期和文件大小打开或切换日志文件
+  bool openLogFile();
+
+  void writeToFile(const std::string &data);
+
+ private:
+  std::vector<LogRing::s_ptr> m_rings;  // 所有线程注册的环形缓冲区
+  int m_index{0};  // 在线程局部缓冲区数组中的下标
 
   // 日志文件格式 file_path/file_name_yymmdd.1, file_path/file_name_yymmdd.2
 
   std::string m_file_name;  // 日志输出文件名称
   std::string m_file_path;  // 日志输出文件路径
-  int m_max_file_size{0};   // 日志单个文件最大大小
+  std::atomic<int> m_max_file_size{0};  // 日志单个文件最大大小
+  int m_sync_interval{0};   // 没有被唤醒时，异步线程取日志的间隔(ms)
 
   sem_t m_semphore;     // 信号量，用于通知线程打印数据到文件
   pthread_t m_pthread;  // 线程句柄
   pthread_cond_t m_condition_variable;  // 条件变量
-  Mutex m_mutex;
+  Mutex m_mutex;  // 保护 m_rings
+
+  std::string m_staging;  // 已取出待写入文件的日志
 
   std::string m_date;             // 上次打印日志的文件日期
-  FILE *m_file_handler{nullptr};  // 当前打开的日志文件句柄
-  bool m_reopen_flag{false};      // 是否需要重新打开文件的标志
+  time_t m_date_expire{0};        // m_date 失效的时间，即下一天零点
+  LogFileWriter::s_ptr m_writer;  // 当前日志文件
   int m_log_num{0};               // 日志文件序号
 
-  bool m_stop_flag{false};
+  std::atomic<bool> m_flush_request{false};
+  std::atomic<bool> m_stop_flag{false};
+  bool m_stopped{false};
 };
 
-enum LogLevel { Unknown = 0, Debug = 1, Info = 2, Error = 3 };
-
-std::string LogLevelToString(LogLevel level);
-
-LogLevel StringToLogLevel(const std::string &log_level);
-
 class Logger {
  public:
   typedef std::shared_ptr<Logger> s_ptr;
@@ -127,15 +451,74 @@ class Logger {
 
   void pushLog(const std::string &msg);
 
+  void pushLog(const char *data, size_t len);
+
   void pushAppLog(const std::string &msg);
 
-  void log();
+  void pushAppLog(const char *data, size_t len);
+
+  // 格式化一行 rpc 日志，file_line 为编译期拼好的 "file:line"
+  template <typename... Args>
+  void log(LogLevel level, const char *file_line, const char *str,
+           Args &&... args) {
+    if (isBinaryMode() &&
+        pushBinaryLog(m_async_logger.get(), level, file_line, str, args...)) {
+      return;
+    }
+    LogLine *line = LogLine::GetThreadLogLine();
+    line->reset(level, file_line);
+    line->format(str, std::forward<Args>(args)...);
+    pushLog(line->data(), line->size());
+  }
+
+  // 格式化一行 app 日志
+  template <typename... Args>
+  void appLog(LogLevel level, const char *file_line, const char *str,
+              Args &&... args) {
+    if (isBinaryMode() && pushBinaryLog(m_async_app_logger.get(), level,
+                                        file_line, str, args...)) {
+      return;
+    }
+    LogLine *line = LogLine::GetThreadLogLine();
+    line->reset(level, file_line);
+    line->format(str, std::forward<Args>(args)...);
+    pushAppLog(line->data(), line->size());
+  }
+
+  LogLevel getLogLevel() const {
+    return m_set_level.load(std::memory_order_relaxed);
+  }
+
+  // 运行时修改日志级别，所有线程立即生效
+  void setLogLevel(LogLevel level) {
+    m_set_level.store(level, std::memory_order_relaxed);
+  }
+
+  // 二进制模式下写日志的线程不做格式化，由AsyncLogger线程完成，
+  // 只对异步日志(type = 1)生效
+  void setBinaryMode(bool value) {
+    m_binary_mode.store(value && m_type != 0, std::memory_order_relaxed);
+  }
+
+  bool isBinaryMode() const {
+    return m_binary_mode.load(std::memory_order_relaxed);
+  }
+
+  // 停止异步日志线程，剩余的日志会全部写入文件
+  void stop();
 
-  LogLevel getLogLevel() const { return m_set_level; }
+  // 线程日志缓冲区写满时丢弃还是等待，默认丢弃
+  void setFullPolicy(LogFullPolicy policy) {
+    m_full_policy.store(policy, std::memory_order_relaxed);
+  }
 
-  void syncLoop();
+  // 因线程日志缓冲区写满而丢弃的日志总条数
+  uint64_t getDropCount() const {
+    return m_drop_count.load(std::memory_order_relaxed);
+  }
 
-  void init();
+  // 修改单个日志文件的最大大小，用于配置热加载
+  void setMaxFileSize(int max_size);
 
  public:
   static Logger *GetGlobalLogger();
@@ -143,13 +526,24 @@ class Logger {
   static void InitGlobalLogger(int type = 1);
 
  private:
-  LogLevel m_set_level;
-  std::vector<std::string> m_buffer;
-  std::vector<std::string> m_app_buffer;
-
-  Mutex m_mutex;
+  void pushToAsyncLogger(AsyncLogger *logger, const char *data, size_t len,
+                         bool binary = false);
+
+  // 参数超出LogRecord大小时返回false，调用方改用文本格式
+  template <typename... Args>
+  bool pushBinaryLog(AsyncLogger *logger, LogLevel level,
+                     const char *file_line, const char *str, Args &&... args) {
+    LogRecord *record = LogRecord::GetThreadLogRecord();
+    record->reset(level, file_line, str);
+    if (!record->encode(args...)) {
+      return false;
+    }
+    pushToAsyncLogger(logger, record->data(), record->size(), true);
+    return true;
+  }
 
-  Mutex m_app_mutex;
+ private:
+  std::atomic<LogLevel> m_set_level;
 
   // 日志文件格式 file_path/file_name_yymmdd.1, file_path/file_name_yymmdd.2
   std::string m_file_name;  // 日志输出文件名称
@@ -160,28 +554,12 @@ class Logger {
 
   AsyncLogger::s_ptr m_async_app_logger;
 
-  TimerEvent::s_ptr m_timer_event;
-
   int m_type{0};
-};
-
-class LogEvent {
- public:
-  LogEvent(LogLevel level) : m_level(level) {}
-
-  std::string getFileName() const { return m_file_name; }
 
-  LogLevel getLogLevel() const { return m_level; }
-
-  std::string toString();
-
- private:
-  std::string m_file_name;  // 文件名
-  int32_t m_file_line;      // 行号
-  int32_t m_pid;            // 进程号
-  int32_t m_thread_id;      // 线程号
+  std::atomic<bool> m_binary_mode{false};
 
-  LogLevel m_level;  //日志级别
+  std::atomic<LogFullPolicy> m_full_policy{LogDropOnFull};
+  std::atomic<uint64_t> m_drop_count{0};
 };
 
 }  // namespace rocket
@@ -0,0 +1,156 @@
+#include "rocket/common/log_file_writer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace rocket {
+
+LogFileWriter::s_ptr LogFileWriter::Create(const std::string &type) {
+  if (type == "mmap") {
+    return std::make_shared<MmapLogFileWriter>();
+  }
+  return std::make_shared<FdLogFileWriter>();
+}
+
+FdLogFileWriter::~FdLogFileWriter() { close(); }
+
+bool FdLogFileWriter::open(const std::string &file_name) {
+  close();
+  m_fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0644);
+  if (m_fd == -1) {
+    return false;
+  }
+  // 追加写入已有文件时从文件当前大小开始累加
+  struct stat file_stat;
+  m_file_size = fstat(m_fd, &file_stat) == 0 ? file_stat.st_size : 0;
+  return true;
+}
+
+bool FdLogFileWriter::write(const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t rt = ::write(m_fd, data, len);
+    if (rt == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += rt;
+    len -= rt;
+    m_file_size += rt;
+  }
+  return true;
+}
+
+void FdLogFileWriter::close() {
+  if (m_fd != -1) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_file_size = 0;
+}
+
+MmapLogFileWriter::~MmapLogFileWriter() { close(); }
+
+bool MmapLogFileWriter::open(const std::string &file_name) {
+  close();
+  m_fd = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (m_fd == -1) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(m_fd, &file_stat) != 0) {
+    close();
+    return false;
+  }
+  m_file_size = findDataEnd(file_stat.st_size);
+  return true;
+}
+
+int64_t MmapLogFileWriter::findDataEnd(int64_t file_size) {
+  // 正常关闭的文件已经截断，只有进程崩溃后留下的文件末尾是预分配的零
+  std::vector<char> buf(64 * 1024);
+  int64_t end = file_size;
+  while (end > 0) {
+    int64_t begin = std::max<int64_t>(0, end - buf.size());
+    ssize_t rt = pread(m_fd, buf.data(), end - begin, begin);
+    if (rt != end - begin) {
+      return file_size;
+    }
+    for (int64_t i = end - begin - 1; i >= 0; i--) {
+      if (buf[i] != '\0') {
+        return begin + i + 1;
+      }
+    }
+    end = begin;
+  }
+  return 0;
+}
+
+bool MmapLogFileWriter::mapChunk(int64_t offset) {
+  unmapChunk();
+  int64_t map_offset = offset / CHUNK_SIZE * CHUNK_SIZE;
+
+  // 预分配空间，避免写映射区时因为磁盘满触发 SIGBUS
+  int rt = posix_fallocate(m_fd, map_offset, CHUNK_SIZE);
+  if (rt != 0) {
+    return false;
+  }
+  void *addr = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    m_fd, map_offset);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  m_map = static_cast<char *>(addr);
+  m_map_offset = map_offset;
+  return true;
+}
+
+void MmapLogFileWriter::unmapChunk() {
+  if (m_map != nullptr) {
+    munmap(m_map, CHUNK_SIZE);
+    m_map = nullptr;
+  }
+}
+
+bool MmapLogFileWriter::write(const char *data, size_t len) {
+  while (len > 0) {
+    if (m_map == nullptr || m_file_size >= m_map_offset + CHUNK_SIZE ||
+        m_file_size < m_map_offset) {
+      if (!mapChunk(m_file_size)) {
+        return false;
+      }
+    }
+    size_t pos = m_file_size - m_map_offset;
+    size_t n = std::min<size_t>(len, CHUNK_SIZE - pos);
+    memcpy(m_map + pos, data, n);
+    data += n;
+    len -= n;
+    m_file_size += n;
+  }
+  return true;
+}
+
+void MmapLogFileWriter::close() {
+  unmapChunk();
+  if (m_fd != -1) {
+    // 去掉预分配但没有用到的空间
+    if (ftruncate(m_fd, m_file_size) != 0) {
+      m_file_size = 0;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_file_size = 0;
+  m_map_offset = 0;
+}
+
+}  // namespace rocket
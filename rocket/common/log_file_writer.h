@@ -0,0 +1,94 @@
+#ifndef ROCKET_COMMON_LOG_FILE_WRITER_H
+#define ROCKET_COMMON_LOG_FILE_WRITER_H
+
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+
+namespace rocket {
+
+// AsyncLogger 写日志文件的后端，只在异步日志线程中使用
+class LogFileWriter {
+ public:
+  using s_ptr = std::shared_ptr<LogFileWriter>;
+
+  virtual ~LogFileWriter() = default;
+
+  // 以追加方式打开日志文件，已经打开的文件会先关闭
+  virtual bool open(const std::string &file_name) = 0;
+
+  virtual bool isOpen() const = 0;
+
+  // 写入全部数据，失败返回false
+  virtual bool write(const char *data, size_t len) = 0;
+
+  // 当前文件中日志的大小
+  virtual int64_t size() const = 0;
+
+  virtual void close() = 0;
+
+ public:
+  // type 为 "mmap" 时使用 MmapLogFileWriter，否则使用 FdLogFileWriter
+  static s_ptr Create(const std::string &type);
+};
+
+// 使用 write(2) 追加写入
+class FdLogFileWriter : public LogFileWriter {
+ public:
+  ~FdLogFileWriter();
+
+  bool open(const std::string &file_name) override;
+
+  bool isOpen() const override { return m_fd != -1; }
+
+  bool write(const char *data, size_t len) override;
+
+  int64_t size() const override { return m_file_size; }
+
+  void close() override;
+
+ private:
+  int m_fd{-1};
+  int64_t m_file_size{0};  // 打开时取文件大小，写入时累加
+};
+
+// 把文件按 CHUNK_SIZE 预分配并映射到内存，写日志只需要 memcpy，
+// 进程崩溃时已经拷贝到映射区的日志仍然会由内核写回文件。
+// 关闭时把文件截断到实际写入的大小
+class MmapLogFileWriter : public LogFileWriter {
+ public:
+  static constexpr int64_t CHUNK_SIZE = 64 * 1024 * 1024;
+
+  ~MmapLogFileWriter();
+
+  bool open(const std::string &file_name) override;
+
+  bool isOpen() const override { return m_fd != -1; }
+
+  bool write(const char *data, size_t len) override;
+
+  int64_t size() const override { return m_file_size; }
+
+  void close() override;
+
+ private:
+  // 映射 offset 所在的 chunk，必要时先预分配文件空间
+  bool mapChunk(int64_t offset);
+
+  void unmapChunk();
+
+  // 找到已有文件中最后一个非零字节之后的位置，跳过上次没有截断的预分配空间
+  int64_t findDataEnd(int64_t file_size);
+
+ private:
+  int m_fd{-1};
+  int64_t m_file_size{0};  // 已写入的日志大小
+
+  char *m_map{nullptr};     // 当前映射的 chunk
+  int64_t m_map_offset{0};  // 当前 chunk 在文件中的偏移
+};
+
+}  // namespace rocket
+
+#endif
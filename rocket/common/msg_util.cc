@@ -1,49 +1,67 @@
 #include "rocket/common/msg_util.h"
 
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
 
 #include "rocket/common/log.h"
+#include "rocket/common/util.h"
 
 namespace rocket {
 
-static int g_msg_id_length = 20;
-static int g_random_fd = -1;
+static thread_local uint64_t t_msg_id = 0;
+static thread_local bool t_msg_id_seeded = false;
 
-static thread_local std::string t_msg_id_no;
-static thread_local std::string t_max_msg_id_no;
+// "00" ~ "99"，每次转换两位数字
+static const char g_digits_lut[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
-std::string MsgUtil::GetMsgID() {
-  if (t_msg_id_no.empty() || t_msg_id_no == t_max_msg_id_no) {
-    if (g_random_fd == -1) {
-      g_random_fd = open("/dev/urandom", O_RDONLY);
-    }
-    std::string res(g_msg_id_length, 0);
-    if ((read(g_random_fd, &res[0], g_msg_id_length)) != g_msg_id_length) {
-      ERRORLOG("read form /dev/urandom error");
-      return "";
-    }
-    for (int i = 0; i < g_msg_id_length; ++i) {
-      uint8_t x = ((uint8_t)(res[i])) % 10;
-      res[i] = x + '0';
-      t_max_msg_id_no += "9";
-    }
-    t_msg_id_no = res;
-  } else {
-    size_t i = t_msg_id_no.length() - 1;
-    while (t_msg_id_no[i] == '9' && i >= 0) {
-      i--;
-    }
-    if (i >= 0) {
-      t_msg_id_no[i] += 1;
-      for (size_t j = i + 1; i < t_msg_id_no.length(); ++j) {
-        t_msg_id_no[j] = '0';
-      }
-    }
+static uint64_t GenerateSeed() {
+  uint64_t seed = 0;
+  if (getrandom(&seed, sizeof(seed), 0) == sizeof(seed)) {
+    return seed;
+  }
+
+  // getrandom 不可用时用时间和线程id混合出初值
+  ERRORLOG("getrandom error, errno=%d, use time and tid as msg_id seed", errno);
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  seed = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  seed ^= static_cast<uint64_t>(getThreadId()) << 40;
+  // splitmix64 打散各个比特
+  seed += 0x9e3779b97f4a7c15ULL;
+  seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+  return seed ^ (seed >> 31);
+}
+
+uint64_t MsgUtil::GetMsgIDNumber() {
+  if (!t_msg_id_seeded) {
+    t_msg_id = GenerateSeed();
+    t_msg_id_seeded = true;
   }
+  return t_msg_id++;
+}
 
-  return t_msg_id_no;
+void MsgUtil::FormatMsgID(uint64_t id, char *buf) {
+  // 从低位往高位每次写两位，固定写满 MSG_ID_LENGTH 位
+  char *p = buf + MSG_ID_LENGTH;
+  for (size_t i = 0; i < MSG_ID_LENGTH / 2; ++i) {
+    p -= 2;
+    memcpy(p, &g_digits_lut[(id % 100) * 2], 2);
+    id /= 100;
+  }
+}
+
+std::string MsgUtil::GetMsgID() {
+  std::string res(MSG_ID_LENGTH, '0');
+  FormatMsgID(GetMsgIDNumber(), &res[0]);
+  return res;
 }
 
-}  // namespace rocket
\ No newline at end of file
+}  // namespace rocket
@@ -1,14 +1,29 @@
 #ifndef ROCKET_COMMON_MSG_UTIL_H
 #define ROCKET_COMMON_MSG_UTIL_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 
 namespace rocket {
+
+// msg_id 由每个线程独立的64位计数器生成，
+// 计数器首次使用时用 getrandom 取随机初值，之后每次加1，不加锁也不读文件
 class MsgUtil {
  public:
+  static constexpr size_t MSG_ID_LENGTH = 20;  // uint64 的十进制最多20位
+
   static std::string GetMsgID();
+
+  // 只取数值形式的msg_id，需要字符串时用 FormatMsgID 转换
+  static uint64_t GetMsgIDNumber();
+
+  // 把id格式化为高位补0的十进制字符串写入buf，
+  // buf 至少 MSG_ID_LENGTH 字节，不写入结尾的 '\0'
+  static void FormatMsgID(uint64_t id, char *buf);
 };
 
 }  // namespace rocket
 
-#endif
\ No newline at end of file
+#endif
@@ -13,20 +13,25 @@ class ScopeMutex {
     m_is_lock = true;
   }
 
+  // 已经手动unlock过时不再重复解锁，否则会释放掉其他线程持有的锁
   ~ScopeMutex() {
-    m_mutex.unlock();
-    m_is_lock = false;
+    if (m_is_lock) {
+      m_mutex.unlock();
+      m_is_lock = false;
+    }
   }
 
   void lock() {
     if (!m_is_lock) {
       m_mutex.lock();
+      m_is_lock = true;
     }
   }
 
   void unlock() {
     if (m_is_lock) {
       m_mutex.unlock();
+      m_is_lock = false;
     }
   }
 
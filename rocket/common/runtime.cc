@@ -1,13 +1,82 @@
 #include "rocket/common/runtime.h"
 
+#include <string.h>
+
+#include <algorithm>
+
 namespace rocket {
-thread_local RunTime* t_run_time = nullptr;
+
 RunTime* RunTime::GetRunTime() {
-  if (t_run_time) {
-    return t_run_time;
+  static thread_local RunTime t_run_time;
+  return &t_run_time;
+}
+
+RequestContext* RequestContext::GetCurrent() {
+  return RunTime::GetRunTime()->m_request_context;
+}
+
+RequestContext::s_ptr RequestContext::CopyCurrent() {
+  RequestContext* current = GetCurrent();
+  if (current == nullptr) {
+    return nullptr;
   }
-  t_run_time = new RunTime();
-  return t_run_time;
+  return std::make_shared<RequestContext>(*current);
+}
+
+static void CopyField(char* dst, size_t size, const std::string& src) {
+  size_t len = std::min(size - 1, src.size());
+  memcpy(dst, src.data(), len);
+  dst[len] = '\0';
+}
+
+void RequestSummary::update(const RequestContext* context) {
+  uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+  m_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (context != nullptr) {
+    CopyField(m_msg_id, sizeof(m_msg_id), context->m_msg_id);
+    CopyField(m_method_name, sizeof(m_method_name), context->m_method_name);
+  } else {
+    m_msg_id[0] = '\0';
+    m_method_name[0] = '\0';
+  }
+  m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool RequestSummary::read(std::string* msg_id,
+                          std::string* method_name) const {
+  char msg_id_buf[sizeof(m_msg_id)];
+  char method_name_buf[sizeof(m_method_name)];
+  for (int i = 0; i < 3; i++) {
+    uint32_t begin = m_sequence.load(std::memory_order_acquire);
+    if (begin % 2 == 1) {
+      continue;
+    }
+    memcpy(msg_id_buf, m_msg_id, sizeof(msg_id_buf));
+    memcpy(method_name_buf, m_method_name, sizeof(method_name_buf));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_sequence.load(std::memory_order_relaxed) == begin) {
+      msg_id_buf[sizeof(msg_id_buf) - 1] = '\0';
+      method_name_buf[sizeof(method_name_buf) - 1] = '\0';
+      *msg_id = msg_id_buf;
+      *method_name = method_name_buf;
+      return true;
+    }
+  }
+  return false;
+}
+
+RequestContextGuard::RequestContextGuard(RequestContext* context) {
+  RunTime* run_time = RunTime::GetRunTime();
+  m_prev = run_time->m_request_context;
+  run_time->m_request_context = context;
+  run_time->m_request_summary.update(context);
+}
+
+RequestContextGuard::~RequestContextGuard() {
+  RunTime* run_time = RunTime::GetRunTime();
+  run_time->m_request_context = m_prev;
+  run_time->m_request_summary.update(m_prev);
 }
 
-}  // namespace rocket
\ No newline at end of file
+}  // namespace rocket
@@ -1,17 +1,92 @@
 #ifndef ROCKET_COMMON_RUNTIME_H
 #define ROCKET_COMMON_RUNTIME_H
 
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
 
 namespace rocket {
-class RunTime {
+
+class NetAddr;
+
+// 一次rpc请求的上下文，处理请求期间通过线程局部指针访问，
+// 日志直接读取其中的字段，不需要拷贝
+class RequestContext {
  public:
-  static RunTime* GetRunTime();
+  using s_ptr = std::shared_ptr<RequestContext>;
+
+  // 当前线程正在处理的请求，没有时返回nullptr
+  static RequestContext* GetCurrent();
+
+  // 拷贝当前线程的请求上下文，用于传给异步回调，没有时返回nullptr
+  static s_ptr CopyCurrent();
+
+  // 返回一个在 context 中执行 cb 的可调用对象，用于异步回调和定时任务
+  template <typename Func>
+  static auto Wrap(s_ptr context, Func cb);
+
+  // 在调用 Wrap 时的请求上下文中执行 cb
+  template <typename Func>
+  static auto Wrap(Func cb) {
+    return Wrap(CopyCurrent(), std::move(cb));
+  }
 
  public:
   std::string m_msg_id;
   std::string m_method_name;
+  int64_t m_deadline_us{0};  // 请求的截止时间(getNowUs，单调时钟)，0表示不限制
+  std::shared_ptr<NetAddr> m_peer_addr;
+  std::shared_ptr<NetAddr> m_local_addr;
+};
+
+// 在作用域内把 context 设为当前线程的请求上下文，析构时恢复之前的上下文
+class RequestContextGuard {
+ public:
+  explicit RequestContextGuard(RequestContext* context);
+
+  ~RequestContextGuard();
+
+  RequestContextGuard(const RequestContextGuard&) = delete;
+  RequestContextGuard& operator=(const RequestContextGuard&) = delete;
+
+ private:
+  RequestContext* m_prev{nullptr};
+};
+
+// 线程当前请求的摘要，供其他线程(例如 EventLoopWatchdog)读取。
+// 只由所属线程在切换请求上下文时写入，读者通过序号判断是否读到了完整的内容
+class RequestSummary {
+ public:
+  void update(const RequestContext* context);
+
+  // 在其他线程中调用，内容一直在变化时返回false
+  bool read(std::string* msg_id, std::string* method_name) const;
+
+ private:
+  std::atomic<uint32_t> m_sequence{0};  // 奇数表示正在写入
+  char m_msg_id[64] = {0};
+  char m_method_name[128] = {0};
+};
+
+class RunTime {
+ public:
+  static RunTime* GetRunTime();
+
+ public:
+  RequestContext* m_request_context{nullptr};  // 当前线程正在处理的请求
+  RequestSummary m_request_summary;            // m_request_context 的摘要
 };
 
+template <typename Func>
+auto RequestContext::Wrap(s_ptr context, Func cb) {
+  return [context, cb](auto&&... args) mutable {
+    RequestContextGuard guard(context.get());
+    return cb(std::forward<decltype(args)>(args)...);
+  };
+}
+
 }  // namespace rocket
-#endif
\ No newline at end of file
+#endif
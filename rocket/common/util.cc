@@ -1,6 +1,8 @@
 #include "rocket/common/util.h"
 #include <arpa/inet.h>
 #include <cstring>
+#include <pthread.h>
+#include <ctime>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -12,18 +14,29 @@ static int g_pid = 0;
 
 static thread_local int g_thread_id = 0;
 
+// fork 出的子进程需要重新获取进程号和线程号
+static void resetCachedIds() {
+  g_pid = 0;
+  g_thread_id = 0;
+}
+
 pid_t getPid() {
   if (g_pid != 0) {
     return g_pid;
   }
-  return getpid();
+  static int g_atfork_registered =
+      pthread_atfork(nullptr, nullptr, &resetCachedIds);
+  (void)g_atfork_registered;
+  g_pid = getpid();
+  return g_pid;
 }
 
 pid_t getThreadId() {
   if (g_thread_id != 0) {
     return g_thread_id;
   }
-  return syscall(SYS_gettid);
+  g_thread_id = syscall(SYS_gettid);
+  return g_thread_id;
 }
 
 int64_t getNowMs() {
@@ -32,6 +45,18 @@ int64_t getNowMs() {
   return now_time.tv_sec * 1000 + now_time.tv_usec / 1000;
 }
 
+int64_t getNowUs() {
+  timespec now_time;
+  clock_gettime(CLOCK_MONOTONIC, &now_time);
+  return now_time.tv_sec * 1000000 + now_time.tv_nsec / 1000;
+}
+
+int64_t getNowNs() {
+  timespec now_time;
+  clock_gettime(CLOCK_MONOTONIC, &now_time);
+  return now_time.tv_sec * 1000000000L + now_time.tv_nsec;
+}
+
 int32_t getInt32FromNetByte(const char *buf) {
   int32_t result;
   memcpy(&result, buf, sizeof(result));
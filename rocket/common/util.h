@@ -11,6 +11,12 @@ pid_t getThreadId();
 
 int64_t getNowMs();
 
+// 单调时钟的当前时间(us)，只用于计算时间间隔
+int64_t getNowUs();
+
+// 单调时钟的当前时间(ns)，用于统计耗时
+int64_t getNowNs();
+
 int32_t getInt32FromNetByte(const char *buf);
 
 } // namespace rocket
@@ -30,132 +30,148 @@ void TinyPBCoder::encode(std::vector<AbstractProtocol::s_ptr> &messages,
 // 将buffer中的字节流转换为message对象
 void TinyPBCoder::decode(std::vector<AbstractProtocol::s_ptr> &out_messages,
                          TcpBuffer::s_ptr buffer) {
-  while (true) {
-    // 遍历buffer，找到PB_START，找到之后解析出整包的长度，然后得到结束符的位置，判断是否为PB_END
-    std::vector<char> tmp = buffer->m_buffer;
-    int start_index = buffer->readIndex();
-
-    int end_index = -1;
-    int pk_len = 0;
-    bool parse_success = false;
-    int i = start_index;
-    for (i = start_index; i < buffer->writeIndex(); i++) {
-      if (tmp[i] == TinyPBProtocol::PB_START) {
-        // 往下取四个字节。注意是网络字节序，需要做转换
-        if (i + 1 < buffer->writeIndex()) {
-          pk_len = getInt32FromNetByte(&tmp[i + 1]);
-          DEBUGLOG("get pk_len = %d", pk_len);
-          // 结束符的索引
-          int j = i + pk_len - 1;
-          if (j >= buffer->writeIndex()) {
-            continue;
-          }
-          if (tmp[j] == TinyPBProtocol::PB_END) {
-            start_index = i;
-            end_index = j;
-            parse_success = true;
-            break;
-          }
-        }
-      }
+  // 包的长度字段来自网络，使用前都要检查，不能信任
+  while (buffer->readAble() > 0) {
+    const char *data = &buffer->m_buffer[buffer->readIndex()];
+    int size = buffer->readAble();
+
+    // 丢弃PB_START之前的无效数据
+    const char *start = reinterpret_cast<const char *>(
+        memchr(data, TinyPBProtocol::PB_START, size));
+    if (start == nullptr) {
+      ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                    "decode error, drop %d bytes without PB_START", size);
+      buffer->moveReadIndex(size);
+      return;
+    }
+    if (start != data) {
+      ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                    "decode error, drop %d bytes before PB_START",
+                    static_cast<int>(start - data));
+      buffer->moveReadIndex(start - data);
+      continue;
     }
 
-    if (i >= buffer->writeIndex()) {
-      DEBUGLOG("decode end, read all buffer data");
+    // 长度字段还没有收完
+    if (size < static_cast<int>(sizeof(char) + sizeof(int32_t))) {
       return;
     }
+    int32_t pk_len = getInt32FromNetByte(&data[1]);
+    if (pk_len < TinyPBProtocol::MIN_PK_LEN ||
+        pk_len > TinyPBProtocol::MAX_PK_LEN) {
+      // 不是真正的包头，跳过这个PB_START继续查找
+      ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                    "decode error, invalid pk_len [%d], skip PB_START",
+                    pk_len);
+      buffer->moveReadIndex(1);
+      continue;
+    }
 
-    if (parse_success) {
-      buffer->moveReadIndex(end_index - start_index + 1);
-      std::shared_ptr<TinyPBProtocol> message =
-          std::make_shared<TinyPBProtocol>();
-      message->m_pk_len = pk_len;
-
-      int msg_id_len_index =
-          start_index + sizeof(char) + sizeof(message->m_pk_len);
-      if (msg_id_len_index >= end_index) {
-        message->parse_success = false;
-        ERRORLOG("parse error, msg_id_len_index[%d] >= end_index[%d]",
-                 msg_id_len_index, end_index);
-        continue;
-      }
-      message->m_msg_id_len = getInt32FromNetByte(&tmp[msg_id_len_index]);
-      DEBUGLOG("parse msg_id_len=%d", message->m_msg_id_len);
-
-      int msg_id_index = msg_id_len_index + sizeof(message->m_msg_id_len);
-
-      char msg_id[100] = {0};
-      memcpy(&msg_id[0], &tmp[msg_id_index], message->m_msg_id_len);
-      message->m_msg_id = std::string(msg_id);
-      DEBUGLOG("parse msg_id=%s", message->m_msg_id.c_str());
-
-      int method_name_len_index = msg_id_index + message->m_msg_id_len;
-      if (method_name_len_index >= end_index) {
-        message->parse_success = false;
-        ERRORLOG("parse error, method_name_len_index[%d] >= end_index[%d]",
-                 method_name_len_index, end_index);
-        continue;
-      }
-      message->m_method_name_len =
-          getInt32FromNetByte(&tmp[method_name_len_index]);
-
-      int method_name_index =
-          method_name_len_index + sizeof(message->m_method_name_len);
-      char method_name[512] = {0};
-      memcpy(&method_name[0], &tmp[method_name_index],
-             message->m_method_name_len);
-      message->m_method_name = std::string(method_name);
-      DEBUGLOG("parse method_name=%s", message->m_method_name.c_str());
-
-      int err_code_index = method_name_index + message->m_method_name_len;
-      if (err_code_index >= end_index) {
-        message->parse_success = false;
-        ERRORLOG("parse error, err_code_index[%d] >= end_index[%d]",
-                 err_code_index, end_index);
-        continue;
-      }
-      message->m_err_code = getInt32FromNetByte(&tmp[err_code_index]);
-
-      int error_info_len_index = err_code_index + sizeof(message->m_err_code);
-      if (error_info_len_index >= end_index) {
-        message->parse_success = false;
-        ERRORLOG("parse error, error_info_len_index[%d] >= end_index[%d]",
-                 error_info_len_index, end_index);
-        continue;
-      }
-      message->m_err_info_len = getInt32FromNetByte(&tmp[error_info_len_index]);
-
-      int err_info_index =
-          error_info_len_index + sizeof(message->m_err_info_len);
-      char error_info[512] = {0};
-      memcpy(&error_info[0], &tmp[err_info_index], message->m_err_info_len);
-      message->m_err_info = std::string(error_info);
-      DEBUGLOG("parse error_info=%s", message->m_err_info.c_str());
-
-      int pb_data_len = message->m_pk_len - message->m_method_name_len -
-                        message->m_msg_id_len - message->m_err_info_len - 2 -
-                        24;
-
-      int pd_data_index = err_info_index + message->m_err_info_len;
-      message->m_pb_data = std::string(&tmp[pd_data_index], pb_data_len);
-
-      // 这里校验和去解析
-      message->parse_success = true;
+    // 整包还没有收完，等待更多数据
+    if (size < pk_len) {
+      return;
+    }
+    if (data[pk_len - 1] != TinyPBProtocol::PB_END) {
+      ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                    "decode error, PB_END not found at pk_len [%d], skip "
+                    "PB_START",
+                    pk_len);
+      buffer->moveReadIndex(1);
+      continue;
+    }
 
+    // 先解析再移动读指针，moveReadIndex可能会搬移buffer中的数据
+    std::shared_ptr<TinyPBProtocol> message = decodeTinyPb(data, pk_len);
+    buffer->moveReadIndex(pk_len);
+    if (message) {
       out_messages.push_back(message);
     }
   }
 }
 
+std::shared_ptr<TinyPBProtocol> TinyPBCoder::decodeTinyPb(const char *data,
+                                                          int32_t pk_len) {
+  std::shared_ptr<TinyPBProtocol> message = std::make_shared<TinyPBProtocol>();
+  message->m_pk_len = pk_len;
+
+  // 跳过PB_START和pk_len，包尾是校验和和PB_END
+  const char *cur = data + sizeof(char) + sizeof(int32_t);
+  const char *end = data + pk_len - sizeof(int32_t) - sizeof(char);
+
+  // 读取 长度+内容 格式的字段，长度为负或超出包尾时返回false
+  auto read_field = [&cur, end](int32_t &len, std::string &value) {
+    if (end - cur < static_cast<int>(sizeof(int32_t))) {
+      return false;
+    }
+    len = getInt32FromNetByte(cur);
+    cur += sizeof(int32_t);
+    if (len < 0 || len > end - cur) {
+      return false;
+    }
+    value.assign(cur, len);
+    cur += len;
+    return true;
+  };
+
+  if (!read_field(message->m_msg_id_len, message->m_msg_id)) {
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "parse error, invalid msg_id_len [%d], pk_len [%d]",
+                  message->m_msg_id_len, pk_len);
+    return nullptr;
+  }
+  if (!read_field(message->m_method_name_len, message->m_method_name)) {
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "%s | parse error, invalid method_name_len [%d], pk_len [%d]",
+                  message->m_msg_id.c_str(), message->m_method_name_len,
+                  pk_len);
+    return nullptr;
+  }
+  if (end - cur < static_cast<int>(sizeof(int32_t))) {
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "%s | parse error, err_code out of package, pk_len [%d]",
+                  message->m_msg_id.c_str(), pk_len);
+    return nullptr;
+  }
+  message->m_err_code = getInt32FromNetByte(cur);
+  cur += sizeof(int32_t);
+  if (!read_field(message->m_err_info_len, message->m_err_info)) {
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "%s | parse error, invalid err_info_len [%d], pk_len [%d]",
+                  message->m_msg_id.c_str(), message->m_err_info_len, pk_len);
+    return nullptr;
+  }
+  // 请求的超时时间，从收到请求开始计算截止时间
+  if (message->m_err_code == 0 &&
+      message->m_err_info_len == TinyPBProtocol::TIMEOUT_FIELD_LEN &&
+      memcmp(message->m_err_info.data(), TinyPBProtocol::TIMEOUT_TAG,
+             sizeof(TinyPBProtocol::TIMEOUT_TAG)) == 0) {
+    message->m_timeout_ms = getInt32FromNetByte(
+        &message->m_err_info[sizeof(TinyPBProtocol::TIMEOUT_TAG)]);
+    message->m_err_info.clear();
+    if (message->m_timeout_ms > 0) {
+      message->m_deadline_us =
+          getNowUs() + static_cast<int64_t>(message->m_timeout_ms) * 1000;
+    }
+  }
+
+  // 剩下的都是pb数据
+  message->m_pb_data.assign(cur, end - cur);
+  message->m_check_sum = getInt32FromNetByte(end);
+
+  // 这里校验和去解析
+  message->parse_success = true;
+  DEBUGLOG("%s | decode message success, method_name [%s], pk_len [%d]",
+           message->m_msg_id.c_str(), message->m_method_name.c_str(), pk_len);
+  return message;
+}
+
 const char *TinyPBCoder::ecncodeTinyPb(std::shared_ptr<TinyPBProtocol> message,
                                        int &len) {
   if (message->m_msg_id.empty()) {
     message->m_msg_id = "123456789";
   }
   DEBUGLOG("msg_id = %s", message->m_msg_id.c_str());
-  int pk_len = 2 + 24 + message->m_msg_id.size() +
-               message->m_method_name.size() + message->m_err_info.size() +
-               message->m_pb_data.size();
+  int pk_len = message->encodedLength();
   DEBUGLOG("pk_len = %d", pk_len);
   char *buf = reinterpret_cast<char *>(malloc(pk_len));
   char *tmp = buf;
@@ -190,13 +206,22 @@ const char *TinyPBCoder::ecncodeTinyPb(std::shared_ptr<TinyPBProtocol> message,
   memcpy(tmp, &err_code_net, sizeof(err_code_net));
   tmp += sizeof(err_code_net);
 
-  int err_info_len = message->m_err_info.size();
+  int err_info_len = message->hasTimeoutField()
+                         ? TinyPBProtocol::TIMEOUT_FIELD_LEN
+                         : message->m_err_info.size();
   int32_t err_info_len_net = htonl(err_info_len);
   memcpy(tmp, &err_info_len_net, sizeof(err_info_len_net));
   tmp += sizeof(err_info_len_net);
 
-  if (!message->m_err_info.empty()) {
-    memcpy(tmp, &(message->m_err_info[0]), sizeof(err_info_len));
+  if (message->hasTimeoutField()) {
+    memcpy(tmp, TinyPBProtocol::TIMEOUT_TAG,
+           sizeof(TinyPBProtocol::TIMEOUT_TAG));
+    tmp += sizeof(TinyPBProtocol::TIMEOUT_TAG);
+    int32_t timeout_net = htonl(message->m_timeout_ms);
+    memcpy(tmp, &timeout_net, sizeof(timeout_net));
+    tmp += sizeof(timeout_net);
+  } else if (!message->m_err_info.empty()) {
+    memcpy(tmp, &(message->m_err_info[0]), err_info_len);
     tmp += err_info_len;
   }
 
@@ -1,5 +1,5 @@
 #ifndef ROCKET_NET_CODER_TINYPB_CODER_H
-#define ROKET_NET_CODER_TINYPB_CODER_H
+#define ROCKET_NET_CODER_TINYPB_CODER_H
 
 #include "rocket/net/coder/abstract_coder.h"
 #include "rocket/net/coder/tinypb_protocol.h"
@@ -19,6 +19,10 @@ public:
 
 private:
   const char *ecncodeTinyPb(std::shared_ptr<TinyPBProtocol> message, int &len);
+
+  // 解析一个以PB_START开头、PB_END结尾的完整包，字段长度非法时返回nullptr
+  std::shared_ptr<TinyPBProtocol> decodeTinyPb(const char *data,
+                                               int32_t pk_len);
 };
 
 } // namespace rocket
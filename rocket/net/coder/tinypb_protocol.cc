@@ -5,5 +5,7 @@ namespace rocket {
 // 静态成员类外初始化
 char TinyPBProtocol::PB_START = 0x02;
 char TinyPBProtocol::PB_END = 0x03;
+// 以'\0'开头，不会和正常的错误信息混淆
+const char TinyPBProtocol::TIMEOUT_TAG[4] = {'\0', 'T', 'M', 'O'};
 
 } // namespace rocket
\ No newline at end of file
@@ -9,22 +9,50 @@ struct TinyPBProtocol : public AbstractProtocol {
   static char PB_START;
   static char PB_END;
 
+  // 除去msg_id、method_name、err_info和pb数据之外的固定长度
+  static constexpr int32_t MIN_PK_LEN = 26;
+  // 解码时允许的最大包长度，超过的视为非法数据
+  static constexpr int32_t MAX_PK_LEN = 64 * 1024 * 1024;
+
+  // 请求的超时时间放在 err_info 字段中: 4字节的 TIMEOUT_TAG 加上网络字节序的
+  // int32 毫秒数。请求原本不使用 err_info，不认识的旧版本服务端会忽略它
+  static const char TIMEOUT_TAG[4];
+  static constexpr int32_t TIMEOUT_FIELD_LEN = 8;
+
  public:
   TinyPBProtocol() {}
   ~TinyPBProtocol() {}
 
+  // 按当前字段编码后的包长度
+  int32_t encodedLength() const {
+    return MIN_PK_LEN + m_msg_id.size() + m_method_name.size() +
+           (hasTimeoutField() ? TIMEOUT_FIELD_LEN : m_err_info.size()) +
+           m_pb_data.size();
+  }
+
+  // 只有没有错误信息的请求才在 err_info 中带上超时时间
+  bool hasTimeoutField() const {
+    return m_timeout_ms > 0 && m_err_code == 0 && m_err_info.empty();
+  }
+
  public:
   int32_t m_pk_len{0};
   int32_t m_msg_id_len{0};
   // msg_id继承父类
   int32_t m_method_name_len{0};
   std::string m_method_name;
-  int32_t m_err_code;
-  int32_t m_err_info_len;
+  int32_t m_err_code{0};
+  int32_t m_err_info_len{0};
   std::string m_err_info;
   std::string m_pb_data;
   int32_t m_check_sum{0};
 
+  // 客户端发送请求时剩余的超时时间(ms)，0表示不限制
+  int32_t m_timeout_ms{0};
+  // 服务端收到请求时按 m_timeout_ms 算出的截止时间(getNowUs，单调时钟)，
+  // 不受系统时间调整的影响，0表示不限制
+  int64_t m_deadline_us{0};
+
   bool parse_success{false};
 };
 
@@ -4,10 +4,14 @@
 #include <sys/eventfd.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 
+#include "rocket/common/config.h"
 #include "rocket/common/log.h"
+#include "rocket/common/runtime.h"
+#include "rocket/net/eventloop_watchdog.h"
 #include "rocket/net/timer.h"
 
 /*
@@ -20,27 +24,39 @@ EPOLL_CTL_DEL：从 epoll 实例中删除文件描述符 fd。
 
 */
 
-#define ADD_TO_EPOLL()                                                  \
-  auto it = m_listen_fds.find(event->getFd());                          \
-  int op = EPOLL_CTL_ADD;                                               \
-  if (it != m_listen_fds.end()) {                                       \
-    op = EPOLL_CTL_MOD;                                                 \
-  }                                                                     \
-  /*获取FdEvent对应的epoll_event*/                                 \
-  epoll_event tmp = event->getEpollEvent();                             \
-  INFOLOG("epoll_event.events = %d", (int)tmp.events);                  \
-  /*epoll中加入或者修改event对应的epoll_event*/               \
-  int rt = epoll_ctl(m_epoll_fd, op, event->getFd(), &tmp);             \
-  if (rt == -1) {                                                       \
-    ERRORLOG("failed epoll_ctl when add fd, errno=%d, errno=%s", errno, \
-             std::strerror(errno));                                     \
-  }                                                                     \
-  m_listen_fds.insert(event->getFd());                                  \
-  DEBUGLOG("add event success, fd [%d]", event->getFd());
+// 注册状态保存在FdEvent中：未注册时ADD，已注册且监听事件有变化时MOD，
+// 监听事件没有变化时不调用epoll_ctl
+#define ADD_TO_EPOLL()                                                      \
+  /*获取FdEvent对应的epoll_event*/                                     \
+  epoll_event tmp = event->getEpollEvent();                                 \
+  int op = EPOLL_CTL_ADD;                                                   \
+  if (event->isRegistered(m_epoll_fd)) {                                    \
+    if (event->getRegisteredEvents() == tmp.events) {                       \
+      return;                                                               \
+    }                                                                       \
+    op = EPOLL_CTL_MOD;                                                     \
+  }                                                                         \
+  /*epoll中加入或者修改event对应的epoll_event*/                   \
+  int rt = epoll_ctl(m_epoll_fd, op, event->getFd(), &tmp);                 \
+  /*fd关闭后被复用时注册状态可能过期，换另一种操作重试*/ \
+  if (rt == -1 && op == EPOLL_CTL_MOD && errno == ENOENT) {                 \
+    op = EPOLL_CTL_ADD;                                                     \
+    rt = epoll_ctl(m_epoll_fd, op, event->getFd(), &tmp);                   \
+  } else if (rt == -1 && op == EPOLL_CTL_ADD && errno == EEXIST) {          \
+    op = EPOLL_CTL_MOD;                                                     \
+    rt = epoll_ctl(m_epoll_fd, op, event->getFd(), &tmp);                   \
+  }                                                                         \
+  if (rt == -1) {                                                           \
+    ERRORLOG("failed epoll_ctl when add fd [%d], errno=%d, error=%s",       \
+             event->getFd(), errno, std::strerror(errno));                  \
+    return;                                                                 \
+  }                                                                         \
+  event->setRegistered(m_epoll_fd, tmp.events);                             \
+  DEBUGLOG("add event success, fd [%d], events [%d]", event->getFd(),       \
+           (int)tmp.events);
 
 #define DEL_TO_EPOLL()                                                 \
-  auto it = m_listen_fds.find(event->getFd());                         \
-  if (it == m_listen_fds.end()) {                                      \
+  if (!event->isRegistered(m_epoll_fd)) {                              \
     return;                                                            \
   }                                                                    \
   int op = EPOLL_CTL_DEL;                                              \
@@ -48,17 +64,25 @@ EPOLL_CTL_DEL：从 epoll 实例中删除文件描述符 fd。
   /*从epoll中删除FdEvent对应的epoll_event*/                     \
   int rt = epoll_ctl(m_epoll_fd, op, event->getFd(), &tmp);            \
   if (rt == -1) {                                                      \
-    ERRORLOG("failed epoll_ctl when add fd errno=%d, error=%s", errno, \
-             std::strerror(errno));                                    \
+    ERRORLOG("failed epoll_ctl when delete fd [%d], errno=%d, error=%s", \
+             event->getFd(), errno, std::strerror(errno));             \
   }                                                                    \
-  m_listen_fds.erase(event->getFd());                                  \
+  event->resetRegistered();                                            \
   DEBUGLOG("delete event success, fd [%d]", event->getFd());
 
 namespace rocket {
 static thread_local EventLoop *t_current_eventloop =
     nullptr;                         // 获取当前线程的eventloop指针
-static int g_epoll_timeout = 10000;  // epoll_wait的延迟时间
-static int g_epoll_max_events = 10;  // epoll_wait等待的事件数量
+// 以下参数可以通过配置修改，加载配置时由 g_config_listener 设置
+static std::atomic<int> g_epoll_timeout{10000};  // epoll_wait的最长延迟时间(ms)
+static std::atomic<int> g_epoll_max_events{16};  // epoll_wait事件数组的初始大小
+static std::atomic<int> g_epoll_max_events_limit{4096};  // epoll_wait事件数组的大小上限
+
+static ConfigListenerRegistrar g_config_listener([](const Config &config) {
+  EventLoop::SetEpollTimeout(config.m_epoll_timeout);
+  EventLoop::SetEpollMaxEvents(config.m_epoll_max_events,
+                               config.m_epoll_max_events_limit);
+});
 
 EventLoop::EventLoop() {
   // 判断当前线程是否已经创建过了eventloop
@@ -67,8 +91,14 @@ EventLoop::EventLoop() {
     exit(0);
   }
 
+  m_epoll_max_events = g_epoll_max_events.load(std::memory_order_relaxed);
+  m_epoll_max_events_limit =
+      g_epoll_max_events_limit.load(std::memory_order_relaxed);
+  m_result_events.resize(m_epoll_max_events);
+
   m_epoll_fd = epoll_create(1);  // 创建epoll实例，返回一个文件描述符
   m_thread_id = getThreadId();  // 获取当前线程id
+  m_run_time = RunTime::GetRunTime();
   if (m_epoll_fd == -1) {
     ERRORLOG(
         "failed to create event loop , epoll_create error , error info[%d]",
@@ -84,9 +114,14 @@ EventLoop::EventLoop() {
   INFOLOG("success create event loop in thread %d", m_thread_id);
 
   t_current_eventloop = this;
+  EventLoopWatchdog::Register(this);
 }
 
 EventLoop::~EventLoop() {
+  EventLoopWatchdog::Unregister(this);
+  if (t_current_eventloop == this) {
+    t_current_eventloop = nullptr;
+  }
   close(m_epoll_fd);  // 关闭文件描述符
   if (m_wakeup_fd_event) {
     // 如果指针没有释放，将其释放
@@ -124,34 +159,50 @@ void EventLoop::initWakeUpFdEvent() {
   m_wakeup_fd_event = new WakeUpFdEvent(m_wakeup_fd);  // new一个wakeUpEvent对象
 
   // 设置为epoll_event为读事件和设置对应回调函数
-  m_wakeup_fd_event->listen(FdEvent::IN_EVENT, [this]() {
-    char buf[8];
-    while (read(m_wakeup_fd, buf, sizeof(buf)) != -1 && errno != EAGAIN &&
-           errno != EWOULDBLOCK) {
-    }
-    DEBUGLOG("read full butes from wakeup fd [%d]", m_wakeup_fd);
-  });
+  m_wakeup_fd_event->listen(FdEvent::IN_EVENT, [this]() { dealWakeup(); });
 
   // 添加到epoll_event中
   addEpollEvent(m_wakeup_fd_event);
 }
 
+void EventLoop::dealWakeup() {
+  // eventfd读一次即可将计数清零
+  char buf[8];
+  if (read(m_wakeup_fd, buf, sizeof(buf)) == -1 && errno != EAGAIN &&
+      errno != EWOULDBLOCK) {
+    ERRORLOG("read wakeup fd [%d] error, errno=%d, error=%s", m_wakeup_fd,
+             errno, std::strerror(errno));
+  }
+}
+
 void EventLoop::loop() {
   m_is_looping = true;
 
+  int64_t last_wait_end = getNowNs();
   while (!m_is_stop_flag) {
+    // 先清除唤醒标志再取任务，之后到来的生产者会重新写eventfd
+    m_wakeup_pending.store(false);
+
     ScopeMutex<Mutex> lock(m_mutex);
     std::queue<std::function<void()>> tmp_tasks;
     m_pending_tasks.swap(
         tmp_tasks);  // 将pending_tasks中数据交换到tmp中去做处理，顺便清空pending_tasks
+    int64_t first_task_ns = m_first_task_ns;
     lock.unlock();
 
-    // 将任务队列中的任务全部处理掉
+    if (!tmp_tasks.empty()) {
+      m_queue_delay_histogram.recordSingleWriter(getNowNs() - first_task_ns);
+    }
+
+    // 将任务队列中的任务全部处理掉，任务序号供 EventLoopWatchdog 检测卡顿
+    uint64_t sequence = m_task_sequence.load(std::memory_order_relaxed);
     while (!tmp_tasks.empty()) {
-      auto cb = tmp_tasks.front();
+      auto cb = std::move(tmp_tasks.front());
       tmp_tasks.pop();
       if (cb) {
+        m_task_sequence.store(++sequence, std::memory_order_relaxed);
         cb();
+        m_task_sequence.store(++sequence, std::memory_order_relaxed);
       }
     }
 
@@ -173,24 +224,67 @@ void EventLoop::loop() {
       成功时，返回发生的事件数量。
       失败时，返回-1，并设置 errno 来指示错误的原因。
     */
-    int timeout = g_epoll_timeout;
-    epoll_event result_events[g_epoll_max_events];  // 用于存储发生的事件
+    int max_events = m_epoll_max_events.load(std::memory_order_relaxed);
+    if (max_events != static_cast<int>(m_result_events.size())) {
+      m_result_events.resize(max_events);
+    }
+    int timeout = getEpollTimeout();
 
-    DEBUGLOG("now begin to epoll_wait");
-    int rt = epoll_wait(m_epoll_fd, result_events, g_epoll_max_events, timeout);
+    DEBUGLOG("now begin to epoll_wait, timeout=%d", timeout);
+    int rt = 0;
+    int64_t wait_begin = getNowNs();
+    if (m_busy_poll_budget_us.load(std::memory_order_relaxed) > 0) {
+      rt = busyPollWait(max_events, timeout);
+    } else {
+      rt = epoll_wait(m_epoll_fd, &m_result_events[0], max_events, timeout);
+    }
+    // 两次等待之间的时间都算作忙碌时间
+    int64_t wait_end = getNowNs();
+    m_busy_ns.fetch_add(wait_begin - last_wait_end, std::memory_order_relaxed);
+    m_busy_histogram.recordSingleWriter(wait_begin - last_wait_end);
+    m_wait_ns.fetch_add(wait_end - wait_begin, std::memory_order_relaxed);
+    last_wait_end = wait_end;
     DEBUGLOG("now end epoll_wait, rt=%d", rt);
 
     if (rt < 0) {
-      ERRORLOG("epoll_wait error ,errno=", errno);
+      if (errno != EINTR) {
+        ERRORLOG("epoll_wait error, errno=%d, error=%s", errno,
+                 std::strerror(errno));
+      }
     } else {
+      m_wait_count.fetch_add(1, std::memory_order_relaxed);
+      m_event_count.fetch_add(rt, std::memory_order_relaxed);
+      if (rt > m_max_batch.load(std::memory_order_relaxed)) {
+        m_max_batch.store(rt, std::memory_order_relaxed);
+      }
+      // 事件数组被填满，说明还有就绪事件没取到，下一轮扩大数组
+      if (rt == max_events) {
+        m_full_count.fetch_add(1, std::memory_order_relaxed);
+        int limit = m_epoll_max_events_limit.load(std::memory_order_relaxed);
+        if (max_events < limit) {
+          int new_size = std::min(max_events * 2, limit);
+          m_epoll_max_events.compare_exchange_strong(max_events, new_size);
+          DEBUGLOG("epoll max events grow to %d", new_size);
+        }
+      }
+
+      bool timer_triggered = false;
       // 处理所有已经发生的事件
       for (int i = 0; i < rt; i++) {
-        epoll_event trigger_event = result_events[i];
+        epoll_event trigger_event = m_result_events[i];
         FdEvent *fd_event = static_cast<FdEvent *>(
             trigger_event.data.ptr);  // 获取到epoll_event对应的FdEvent
         if (fd_event == nullptr) {
           continue;
         }
+        // wakeup fd 直接在这里读空，不再放入任务队列
+        if (fd_event == m_wakeup_fd_event) {
+          dealWakeup();
+          continue;
+        }
+        if (fd_event == m_timer) {
+          timer_triggered = true;
+        }
         // 将对应的event的回调函数添加到任务队列中
         if (trigger_event.events & EPOLLIN) {
           DEBUGLOG("fd %d trigger EPOLLIN event", fd_event->getFd());
@@ -211,10 +305,115 @@ void EventLoop::loop() {
           }
         }
       }
+
+      // 超时是按最近的定时任务计算的，到期时不必再等timerfd
+      if (!timer_triggered) {
+        int64_t next = m_timer->getNextArriveTime();
+        if (next != -1 && next <= getNowMs()) {
+          addTask(m_timer->handler(FdEvent::IN_EVENT));
+        }
+      }
+    }
+  }
+}
+
+int EventLoop::getEpollTimeout() {
+  // 还有待处理的任务时不阻塞
+  ScopeMutex<Mutex> lock(m_mutex);
+  bool has_task = !m_pending_tasks.empty();
+  lock.unlock();
+  if (has_task) {
+    return 0;
+  }
+
+  int64_t next = m_timer->getNextArriveTime();
+  if (next == -1) {
+    return g_epoll_timeout.load(std::memory_order_relaxed);
+  }
+  int64_t interval = next - getNowMs();
+  if (interval <= 0) {
+    return 0;
+  }
+  return static_cast<int>(std::min<int64_t>(
+      interval, g_epoll_timeout.load(std::memory_order_relaxed)));
+}
+
+int EventLoop::busyPollWait(int max_events, int timeout) {
+  int rt = epoll_wait(m_epoll_fd, &m_result_events[0], max_events, 0);
+  if (rt != 0 || timeout == 0) {
+    return rt;
+  }
+
+  // 自旋时间不超过预算，也不超过下一个定时任务的到达时间
+  int64_t budget = m_busy_poll_budget_us.load(std::memory_order_relaxed);
+  if (timeout > 0) {
+    budget = std::min<int64_t>(budget, static_cast<int64_t>(timeout) * 1000);
+  }
+  int64_t start = getNowUs();
+  int64_t now = start;
+  while (now - start < budget) {
+    rt = epoll_wait(m_epoll_fd, &m_result_events[0], max_events, 0);
+    if (rt != 0) {
+      return rt;
     }
+    now = getNowUs();
+  }
+
+  if (timeout > 0) {
+    timeout = std::max<int>(0, timeout - static_cast<int>((now - start) / 1000));
   }
+  return epoll_wait(m_epoll_fd, &m_result_events[0], max_events, timeout);
 }
 
+void EventLoop::setBusyPoll(int spin_budget_us, int socket_busy_poll_us) {
+  m_busy_poll_budget_us = std::max(0, spin_budget_us);
+  m_socket_busy_poll_us = std::max(0, socket_busy_poll_us);
+  INFOLOG("event loop in thread %d set busy poll, spin budget [%d us], "
+          "SO_BUSY_POLL [%d us]",
+          m_thread_id, spin_budget_us, socket_busy_poll_us);
+}
+
+void EventLoop::setEpollMaxEvents(int size) {
+  if (size <= 0) {
+    ERRORLOG("invalid epoll max events %d", size);
+    return;
+  }
+  m_epoll_max_events = size;
+  if (size > m_epoll_max_events_limit) {
+    m_epoll_max_events_limit = size;
+  }
+}
+
+void EventLoop::setEpollMaxEventsLimit(int limit) {
+  if (limit <= 0) {
+    ERRORLOG("invalid epoll max events limit %d", limit);
+    return;
+  }
+  m_epoll_max_events_limit = limit;
+  if (m_epoll_max_events > limit) {
+    m_epoll_max_events = limit;
+  }
+}
+
+EpollStats EventLoop::getEpollStats() const {
+  EpollStats stats;
+  stats.wait_count = m_wait_count.load(std::memory_order_relaxed);
+  stats.event_count = m_event_count.load(std::memory_order_relaxed);
+  stats.full_count = m_full_count.load(std::memory_order_relaxed);
+  stats.max_batch = m_max_batch.load(std::memory_order_relaxed);
+  stats.max_events = m_epoll_max_events.load(std::memory_order_relaxed);
+  stats.wait_ns = m_wait_ns.load(std::memory_order_relaxed);
+  stats.busy_ns = m_busy_ns.load(std::memory_order_relaxed);
+  return stats;
+}
+
+size_t EventLoop::getPendingTaskCount() {
+  ScopeMutex<Mutex> lock(m_mutex);
+  return m_pending_tasks.size();
+}
+
+size_t EventLoop::getTimerCount() { return m_timer->getTimerEventCount(); }
+
 void EventLoop::addEpollEvent(FdEvent *event) {
   // 判断是否为当前线程，如果不是只需要添加epoll中，不需要添加到任务队列中
   if (isInLoopThread()) {
@@ -237,11 +436,19 @@ void EventLoop::deleteEpollEvent(FdEvent *event) {
 
 void EventLoop::addTask(std::function<void()> cb, bool is_wake_up) {
   ScopeMutex<Mutex> lock(m_mutex);
-  m_pending_tasks.push(cb);
+  // 只在队列为空时读时钟，记录的是本轮等待最久的任务的入队时间
+  if (m_pending_tasks.empty()) {
+    m_first_task_ns = getNowNs();
+  }
+  m_pending_tasks.push(std::move(cb));
   lock.unlock();
-  // 判断是否需要wake_up
+  // 判断是否需要wake_up，loop处理前只需要第一个生产者写eventfd
   if (is_wake_up) {
-    wakeup();
+    if (!m_wakeup_pending.exchange(true)) {
+      wakeup();
+    } else {
+      m_saved_wakeup_count.fetch_add(1, std::memory_order_relaxed);
+    }
   }
 }
 
@@ -249,6 +456,11 @@ void EventLoop::addTimerEvent(TimerEvent::s_ptr event) {
   m_timer->addTimerEvent(event);
 }
 
+uint64_t EventLoop::GetCurrentTaskSequence() {
+  EventLoop *event_loop = t_current_eventloop;
+  return event_loop != nullptr ? event_loop->getTaskSequence() : 0;
+}
+
 EventLoop *EventLoop::GetCurrentEventLoop() {
   if (t_current_eventloop) {
     return t_current_eventloop;
@@ -257,6 +469,15 @@ EventLoop *EventLoop::GetCurrentEventLoop() {
   return t_current_eventloop;
 }
 
+void EventLoop::SetEpollTimeout(int timeout_ms) {
+  g_epoll_timeout.store(timeout_ms, std::memory_order_relaxed);
+}
+
+void EventLoop::SetEpollMaxEvents(int max_events, int max_events_limit) {
+  g_epoll_max_events.store(max_events, std::memory_order_relaxed);
+  g_epoll_max_events_limit.store(max_events_limit, std::memory_order_relaxed);
+}
+
 void EventLoop::stop() {
   m_is_stop_flag = true;
   wakeup();
@@ -1,12 +1,14 @@
-#ifndef ROCKET_NET_EVENTLOOP_h
+#ifndef ROCKET_NET_EVENTLOOP_H
 #define ROCKET_NET_EVENTLOOP_H
 #include <pthread.h>
 
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <queue>
-#include <set>
+#include <vector>
 
+#include "rocket/common/histogram.h"
 #include "rocket/common/mutex.h"
 #include "rocket/common/util.h"
 #include "rocket/net/fd_event.h"
@@ -15,6 +17,20 @@
 #include "rocket/net/wakeup_fd_event.h"
 
 namespace rocket {
+
+class RunTime;
+
+// epoll_wait 的统计信息
+struct EpollStats {
+  uint64_t wait_count{0};   // epoll_wait 调用次数
+  uint64_t event_count{0};  // 返回的事件总数
+  uint64_t full_count{0};   // 事件数组被填满的次数
+  int max_batch{0};         // 单次返回的最大事件数
+  int max_events{0};        // 当前事件数组大小
+  uint64_t wait_ns{0};      // 阻塞或自旋等待事件的总耗时
+  uint64_t busy_ns{0};      // 处理事件和任务的总耗时
+};
+
 class EventLoop {
  public:
   EventLoop();
@@ -47,28 +63,128 @@ class EventLoop {
   // 是否正在looping
   bool isLooping() const { return m_is_looping; }
 
+  // 设置epoll_wait事件数组的大小，数组被填满时会自动翻倍直到上限
+  void setEpollMaxEvents(int size);
+
+  // 设置epoll_wait事件数组自动增长的上限
+  void setEpollMaxEventsLimit(int limit);
+
+  EpollStats getEpollStats() const;
+
+  // 任务队列中等待执行的任务数
+  size_t getPendingTaskCount();
+
+  // 定时器中未到期的定时任务数
+  size_t getTimerCount();
+
+  // 任务序号，每个任务开始和结束时各加一，奇数表示正在执行任务。
+  // EventLoopWatchdog 发现序号长时间不变且为奇数时认为loop卡住了，
+  // 这样loop线程执行每个任务时不需要读时钟
+  uint64_t getTaskSequence() const {
+    return m_task_sequence.load(std::memory_order_relaxed);
+  }
+
+  // loop所在线程的id
+  pid_t getLoopThreadId() const { return m_thread_id; }
+
+  // loop所在线程的RunTime，其他线程只能读取其中的 m_request_summary
+  RunTime *getLoopRunTime() const { return m_run_time; }
+
+  // 每轮循环处理事件和任务的耗时(ns)
+  const LatencyHistogram &getBusyHistogram() const { return m_busy_histogram; }
+
+  // 任务从addTask到开始执行的延迟(ns)，每轮只记录队首的任务，
+  // 也就是本轮等待最久的任务
+  const LatencyHistogram &getQueueDelayHistogram() const {
+    return m_queue_delay_histogram;
+  }
+
+  // 挂在该loop上的服务端连接数，由TcpConnection维护
+  void addConnectionCount(int delta) {
+    m_connection_count.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int getConnectionCount() const {
+    return m_connection_count.load(std::memory_order_relaxed);
+  }
+
+  // 忙轮询模式：阻塞前先用 epoll_wait(..., 0) 自旋 spin_budget_us 微秒，
+  // socket_busy_poll_us > 0 时还会给新连接设置 SO_BUSY_POLL，
+  // spin_budget_us 为 0 表示关闭忙轮询
+  void setBusyPoll(int spin_budget_us, int socket_busy_poll_us = 0);
+
+  int getBusyPollBudget() const { return m_busy_poll_budget_us; }
+
+  int getSocketBusyPoll() const { return m_socket_busy_poll_us; }
+
+  // 因合并唤醒而省掉的eventfd写次数
+  uint64_t getSavedWakeupCount() const {
+    return m_saved_wakeup_count.load(std::memory_order_relaxed);
+  }
+
  public:
   static EventLoop *GetCurrentEventLoop();
 
+  // 当前线程的loop的任务序号，没有loop时返回0。
+  // 只读线程局部变量和原子变量，可以在信号处理函数中调用
+  static uint64_t GetCurrentTaskSequence();
+
+  // 没有定时任务时epoll_wait的最长等待时间(ms)，对所有EventLoop立即生效
+  static void SetEpollTimeout(int timeout_ms);
+
+  // epoll_wait事件数组的初始大小和上限，只对之后创建的EventLoop生效
+  static void SetEpollMaxEvents(int max_events, int max_events_limit);
+
  private:
-  void dealWakeup(){};
+  // 读空wakeup fd
+  void dealWakeup();
 
   // 初始化wakeUpEvent
   void initWakeUpFdEvent();
 
   void initTimer();
 
+  // 根据最近的定时任务计算epoll_wait的超时时间
+  int getEpollTimeout();
+
+  // 按忙轮询预算自旋等待，预算用完还没有事件时再阻塞等待
+  int busyPollWait(int max_events, int timeout);
+
  private:
   pid_t m_thread_id{0};                       // 当前线程id
+  RunTime *m_run_time{nullptr};               // 当前线程的RunTime
   int m_epoll_fd{0};                          // 标识epoll实例
   int m_wakeup_fd{0};                         // wakeUpEvent的fd
   WakeUpFdEvent *m_wakeup_fd_event{nullptr};  // wakeUpEvent对应的指针
   bool m_is_stop_flag{false};                 // loop循环停止的标志
   bool m_is_looping{false};                   // 是否正在loop中
-  std::set<int> m_listen_fds;  // 储存Reactor模型监听的文件描述符列表
   std::queue<std::function<void()>> m_pending_tasks;  // 待决任务队列
+  int64_t m_first_task_ns{0};  // 队首任务的入队时间，用于统计排队延迟
   Mutex m_mutex;                                      // 互斥锁
   Timer *m_timer{nullptr};                            // 定时器
+
+  // 已有生产者写过eventfd且loop还未处理，后续addTask无需再次写入
+  std::atomic<bool> m_wakeup_pending{false};
+  std::atomic<uint64_t> m_saved_wakeup_count{0};  // 省掉的唤醒次数
+
+  std::vector<epoll_event> m_result_events;     // epoll_wait返回的事件
+  std::atomic<int> m_epoll_max_events{0};        // 期望的事件数组大小
+  std::atomic<int> m_epoll_max_events_limit{0};  // 事件数组大小上限
+
+  std::atomic<uint64_t> m_wait_count{0};
+  std::atomic<uint64_t> m_event_count{0};
+  std::atomic<uint64_t> m_full_count{0};
+  std::atomic<int> m_max_batch{0};
+  std::atomic<uint64_t> m_wait_ns{0};
+  std::atomic<uint64_t> m_busy_ns{0};
+  std::atomic<int> m_connection_count{0};
+
+  std::atomic<uint64_t> m_task_sequence{0};
+  LatencyHistogram m_busy_histogram;
+  LatencyHistogram m_queue_delay_histogram;
+
+  std::atomic<int> m_busy_poll_budget_us{0};  // 忙轮询自旋预算(us)
+  std::atomic<int> m_socket_busy_poll_us{0};  // socket的SO_BUSY_POLL(us)
 };
 
 }  // namespace rocket
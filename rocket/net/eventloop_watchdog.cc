@@ -0,0 +1,303 @@
+#include "rocket/net/eventloop_watchdog.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/common/mutex.h"
+#include "rocket/common/runtime.h"
+#include "rocket/common/util.h"
+#include "rocket/net/eventloop.h"
+
+namespace rocket {
+
+static const int MAX_STACK_DEPTH = 64;
+
+// 等待被检测线程抓取调用栈的最长时间
+static const int CAPTURE_TIMEOUT_MS = 100;
+
+// 被检测线程在信号处理函数中填写，同一时刻只抓取一个线程
+struct StallTrace {
+  uint64_t task_sequence{0};  // 抓栈时当前线程的loop的任务序号
+  void *frames[MAX_STACK_DEPTH];
+  int depth{0};
+  std::atomic<bool> ready{false};
+};
+
+static StallTrace g_stall_trace;
+
+// 当前抓栈请求的编号，随信号一起发送，0表示没有等待中的请求。
+// 信号处理函数和超时的检测线程都通过CAS把它置为0，只有成功的一方能访问
+// g_stall_trace，迟到的信号不会覆盖之后的抓栈结果
+static std::atomic<uint32_t> g_capture_token{0};
+static uint32_t g_next_token = 0;  // 只在检测线程中访问
+
+// 信号处理函数已经开始执行但超时没有写完，写完之前不能发起下一次抓栈，
+// 只在检测线程中访问
+static bool g_is_capture_abandoned = false;
+
+static std::atomic<int> g_stall_threshold_ms{0};
+static std::atomic<bool> g_capture_stack{false};
+static std::atomic<uint64_t> g_stall_count{0};
+static std::atomic<bool> g_is_started{false};
+static std::atomic<bool> g_is_signal_installed{false};
+
+static ConfigListenerRegistrar g_config_listener([](const Config &config) {
+  EventLoopWatchdog::SetCaptureStack(config.m_stall_capture_stack);
+  EventLoopWatchdog::SetStallThreshold(config.m_stall_threshold);
+});
+
+// 所有存活的EventLoop，持锁期间不会被析构，检测线程只在持锁时短暂访问
+static Mutex g_loops_mutex;
+static std::set<EventLoop *> *g_loops = new std::set<EventLoop *>();
+
+static int StackSignal() { return SIGRTMIN + 1; }
+
+// 在卡住的线程中执行，只调用可重入的函数，不能分配内存和加锁。
+// 不使用检测线程记录的 EventLoop 指针，收到信号时它可能已经析构
+static void OnStackSignal(int, siginfo_t *info, void *) {
+  uint32_t token = static_cast<uint32_t>(info->si_value.sival_int);
+  uint32_t expected = token;
+  if (token == 0 || !g_capture_token.compare_exchange_strong(
+                        expected, 0, std::memory_order_acq_rel)) {
+    return;  // 检测线程已经放弃了这次抓栈
+  }
+  int saved_errno = errno;
+  g_stall_trace.task_sequence = EventLoop::GetCurrentTaskSequence();
+  g_stall_trace.depth = backtrace(g_stall_trace.frames, MAX_STACK_DEPTH);
+  g_stall_trace.ready.store(true, std::memory_order_release);
+  errno = saved_errno;
+}
+
+// 等待 g_stall_trace 写完，最多等待 timeout_ms
+static bool WaitStallTrace(int timeout_ms) {
+  for (int i = 0; i < timeout_ms * 10; i++) {
+    if (g_stall_trace.ready.load(std::memory_order_acquire)) {
+      return true;
+    }
+    usleep(100);
+  }
+  return false;
+}
+
+// 抓取线程 tid 的调用栈，失败或超时返回false
+static bool CaptureStack(pid_t tid) {
+  if (g_is_capture_abandoned) {
+    if (!g_stall_trace.ready.load(std::memory_order_acquire)) {
+      return false;
+    }
+    g_is_capture_abandoned = false;
+  }
+
+  g_stall_trace.ready.store(false, std::memory_order_relaxed);
+  if (++g_next_token == 0) {
+    ++g_next_token;
+  }
+  uint32_t token = g_next_token;
+  g_capture_token.store(token, std::memory_order_release);
+
+  siginfo_t info;
+  memset(&info, 0, sizeof(info));
+  info.si_signo = StackSignal();
+  info.si_code = SI_QUEUE;
+  info.si_pid = getpid();
+  info.si_uid = getuid();
+  info.si_value.sival_int = static_cast<int>(token);
+  if (syscall(SYS_rt_tgsigqueueinfo, getPid(), tid, StackSignal(), &info) !=
+      0) {
+    g_capture_token.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  if (WaitStallTrace(CAPTURE_TIMEOUT_MS)) {
+    return true;
+  }
+
+  uint32_t expected = token;
+  if (g_capture_token.compare_exchange_strong(expected, 0,
+                                              std::memory_order_acq_rel)) {
+    return false;
+  }
+  // 信号处理函数已经开始执行，再等一会，仍然没写完时放弃
+  if (WaitStallTrace(CAPTURE_TIMEOUT_MS)) {
+    return true;
+  }
+  g_is_capture_abandoned = true;
+  return false;
+}
+
+// 检测线程在持锁时记录的卡住的loop，报告时不再持锁
+struct StalledLoop {
+  pid_t tid{0};
+  uint64_t task_sequence{0};
+  int64_t stall_ms{0};
+  std::string msg_id;
+  std::string method_name;
+};
+
+static void ReportStall(const StalledLoop &stalled) {
+  g_stall_count.fetch_add(1, std::memory_order_relaxed);
+
+  if (!g_capture_stack.load(std::memory_order_relaxed)) {
+    ERRORLOG("eventloop in thread [%d] stalled for more than %ld ms in one "
+             "task, msg_id [%s], method [%s]",
+             stalled.tid, stalled.stall_ms, stalled.msg_id.c_str(),
+             stalled.method_name.c_str());
+    return;
+  }
+
+  // 信号到达前任务可能已经结束，此时的调用栈没有意义
+  if (!CaptureStack(stalled.tid) ||
+      g_stall_trace.task_sequence != stalled.task_sequence) {
+    ERRORLOG("eventloop in thread [%d] stalled for more than %ld ms in one "
+             "task, msg_id [%s], method [%s], failed to capture stack",
+             stalled.tid, stalled.stall_ms, stalled.msg_id.c_str(),
+             stalled.method_name.c_str());
+    return;
+  }
+
+  std::string stack;
+  char **symbols =
+      backtrace_symbols(g_stall_trace.frames, g_stall_trace.depth);
+  for (int i = 0; i < g_stall_trace.depth; i++) {
+    stack += formatString("  #%d %s\n", i,
+                          symbols ? symbols[i] : "<unknown>");
+  }
+  free(symbols);
+
+  ERRORLOG("eventloop in thread [%d] stalled for more than %ld ms in one "
+           "task, msg_id [%s], method [%s], stack:\n%s",
+           stalled.tid, stalled.stall_ms, stalled.msg_id.c_str(),
+           stalled.method_name.c_str(), stack.c_str());
+}
+
+// 检测线程观察到的每个loop的状态
+struct LoopState {
+  uint64_t task_sequence{0};
+  int64_t first_seen_ns{0};  // 第一次观察到该任务序号的时间
+  bool reported{false};      // 同一个任务只报告一次
+};
+
+static void *WatchdogMain(void *) {
+  std::map<EventLoop *, LoopState> states;
+  while (true) {
+    int threshold_ms = g_stall_threshold_ms.load(std::memory_order_relaxed);
+    int interval_ms = threshold_ms > 0 ? threshold_ms / 4 : 1000;
+    usleep(std::max(10, std::min(interval_ms, 1000)) * 1000);
+    if (threshold_ms <= 0) {
+      continue;
+    }
+
+    // 持锁时只读取状态，报告和抓栈在释放锁之后进行，不阻塞 EventLoop 的析构
+    int64_t threshold_ns = static_cast<int64_t>(threshold_ms) * 1000000;
+    std::vector<StalledLoop> stalled_loops;
+    ScopeMutex<Mutex> lock(g_loops_mutex);
+    int64_t now = getNowNs();
+    for (EventLoop *event_loop : *g_loops) {
+      uint64_t sequence = event_loop->getTaskSequence();
+      LoopState &state = states[event_loop];
+      if (sequence != state.task_sequence || state.first_seen_ns == 0) {
+        state.task_sequence = sequence;
+        state.first_seen_ns = now;
+        state.reported = false;
+        continue;
+      }
+      // 序号为奇数且一直没变，说明同一个任务执行了至少这么久
+      if (sequence % 2 == 1 && !state.reported &&
+          now - state.first_seen_ns >= threshold_ns) {
+        state.reported = true;
+        StalledLoop stalled;
+        stalled.tid = event_loop->getLoopThreadId();
+        stalled.task_sequence = sequence;
+        stalled.stall_ms = (now - state.first_seen_ns) / 1000000;
+        if (!event_loop->getLoopRunTime()->m_request_summary.read(
+                &stalled.msg_id, &stalled.method_name)) {
+          stalled.msg_id = stalled.method_name = "<changing>";
+        }
+        stalled_loops.push_back(stalled);
+      }
+    }
+    for (auto it = states.begin(); it != states.end();) {
+      if (g_loops->count(it->first) == 0) {
+        it = states.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    lock.unlock();
+
+    for (auto &stalled : stalled_loops) {
+      ReportStall(stalled);
+    }
+  }
+  return NULL;
+}
+
+// 第一次设置了阈值且已经有loop注册时启动检测线程。
+// loop在日志初始化之后才会创建，这里可以使用日志
+static void StartWatchdog() {
+  if (g_stall_threshold_ms.load(std::memory_order_relaxed) <= 0 ||
+      g_is_started.exchange(true)) {
+    return;
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &WatchdogMain, NULL) != 0) {
+    ERRORLOG("create eventloop watchdog thread error, errno=%d", errno);
+    g_is_started = false;
+    return;
+  }
+  pthread_detach(thread);
+}
+
+void EventLoopWatchdog::SetStallThreshold(int threshold_ms) {
+  g_stall_threshold_ms.store(threshold_ms, std::memory_order_relaxed);
+  ScopeMutex<Mutex> lock(g_loops_mutex);
+  if (!g_loops->empty()) {
+    StartWatchdog();
+  }
+}
+
+void EventLoopWatchdog::SetCaptureStack(bool capture_stack) {
+  if (capture_stack && !g_is_signal_installed.exchange(true)) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = &OnStackSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(StackSignal(), &sa, NULL);
+
+    // 第一次调用backtrace会加载libgcc，提前调用，避免在信号处理函数中分配内存
+    void *frames[1];
+    backtrace(frames, 1);
+  }
+  g_capture_stack.store(capture_stack, std::memory_order_relaxed);
+}
+
+void EventLoopWatchdog::Register(EventLoop *event_loop) {
+  ScopeMutex<Mutex> lock(g_loops_mutex);
+  g_loops->insert(event_loop);
+  StartWatchdog();
+}
+
+void EventLoopWatchdog::Unregister(EventLoop *event_loop) {
+  ScopeMutex<Mutex> lock(g_loops_mutex);
+  g_loops->erase(event_loop);
+}
+
+uint64_t EventLoopWatchdog::GetStallCount() {
+  return g_stall_count.load(std::memory_order_relaxed);
+}
+
+}  // namespace rocket
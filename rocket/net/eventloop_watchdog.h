@@ -0,0 +1,36 @@
+#ifndef ROCKET_NET_EVENTLOOP_WATCHDOG_H
+#define ROCKET_NET_EVENTLOOP_WATCHDOG_H
+
+#include <stdint.h>
+
+namespace rocket {
+
+class EventLoop;
+
+// 检测卡住的 EventLoop。
+// 一个耗时的任务(例如在rpc方法里sleep)会卡住同一个IO线程上的所有连接，
+// 后台线程定期检查每个loop当前任务的开始时间，超过阈值时把线程、正在处理的请求
+// 和耗时打印到错误日志，同一个任务只报告一次。
+// 开启抓栈后还会向该线程发送信号抓取调用栈，调用栈需要链接时加 -rdynamic
+// 才能显示函数名，否则可以用 addr2line 解析地址。
+// 注意抓栈的信号会打断被检测线程中的 sleep 等阻塞调用，使其提前返回(EINTR)
+class EventLoopWatchdog {
+ public:
+  // 设置卡顿阈值(ms)，0表示关闭检测。阈值大于0时在有 EventLoop 注册后启动检测线程
+  static void SetStallThreshold(int threshold_ms);
+
+  // 报告卡顿时是否抓取调用栈，第一次开启时安装信号处理函数
+  static void SetCaptureStack(bool capture_stack);
+
+  // 由 EventLoop 的构造和析构函数调用
+  static void Register(EventLoop *event_loop);
+
+  static void Unregister(EventLoop *event_loop);
+
+  // 检测到的卡顿次数
+  static uint64_t GetStallCount();
+};
+
+}  // namespace rocket
+
+#endif
@@ -37,12 +37,35 @@ class FdEvent {
 
   void cancel(TriggerEvent event_type);
 
+  // 是否已经注册到 epoll_fd 对应的epoll中，只在所属eventloop线程中访问
+  bool isRegistered(int epoll_fd) const {
+    return m_registered_epoll_fd == epoll_fd;
+  }
+
+  // 注册到epoll中的事件
+  uint32_t getRegisteredEvents() const { return m_registered_events; }
+
+  // 记录注册到了哪个epoll以及注册的事件
+  void setRegistered(int epoll_fd, uint32_t events) {
+    m_registered_epoll_fd = epoll_fd;
+    m_registered_events = events;
+  }
+
+  // 置为未注册，fd关闭或者被新的连接复用时调用
+  void resetRegistered() {
+    m_registered_epoll_fd = -1;
+    m_registered_events = 0;
+  }
+
  protected:
   int m_fd{-1};                                     // 文件描述符
   epoll_event m_listen_event;                       // 监听事件
   std::function<void()> m_read_callback{nullptr};   // 读回调
   std::function<void()> m_write_callback{nullptr};  // 写回调
   std::function<void()> m_error_callback{nullptr};  // 错误回调
+
+  int m_registered_epoll_fd{-1};    // 注册到的epoll，-1表示未注册
+  uint32_t m_registered_events{0};  // 注册到epoll中的事件
 };
 
 }  // namespace rocket
@@ -1,42 +1,77 @@
 #include "rocket/net/fd_event_group.h"
+#include "rocket/common/log.h"
+#include <new>
 
 namespace rocket {
 
-static FdEventGroup *g_fd_event_group = nullptr;
-
-FdEventGroup::FdEventGroup(int size) : m_size(size) {
-  for (int i = 0; i < m_size; i++) {
-    m_fd_group.push_back(new FdEvent(i));
+FdEventGroup::FdEventGroup(int size) {
+  for (int i = 0; i < MAX_FD_PAGES; i++) {
+    m_pages[i].store(nullptr, std::memory_order_relaxed);
+  }
+  // 预先分配能覆盖size个fd的页
+  for (int i = 0; i < size && i < MAX_FDS; i += FD_PAGE_SIZE) {
+    getPage(i >> FD_PAGE_SHIFT);
   }
 }
 
 FdEventGroup::~FdEventGroup() {
-  for (int i = 0; i < m_size; i++) {
-    if (m_fd_group[i] != nullptr) {
-      delete m_fd_group[i];
-      m_fd_group[i] = nullptr;
+  for (int i = 0; i < MAX_FD_PAGES; i++) {
+    FdEvent *page = m_pages[i].exchange(nullptr, std::memory_order_acq_rel);
+    if (page != nullptr) {
+      DeletePage(page);
     }
   }
 }
 
 FdEventGroup *FdEventGroup::GetFdEventGroup() {
-  if (g_fd_event_group) {
-    return g_fd_event_group;
-  }
-  g_fd_event_group = new FdEventGroup(128);
+  // 局部静态变量的初始化是线程安全的
+  static FdEventGroup *g_fd_event_group = new FdEventGroup(128);
   return g_fd_event_group;
 }
 
 FdEvent *FdEventGroup::getFdEvent(int fd) {
-  ScopeMutex<Mutex> lock(m_mutex);
-  if (fd < static_cast<int>(m_fd_group.size())) {
-    return m_fd_group[fd];
+  if (fd < 0 || fd >= MAX_FDS) {
+    ERRORLOG("getFdEvent error, fd [%d] out of range [0, %d)", fd, MAX_FDS);
+    return nullptr;
   }
-  int new_size = static_cast<int>(fd * 1.5);
-  for (int i = m_fd_group.size(); i < new_size; i++) {
-    m_fd_group.push_back(new FdEvent(i));
+  FdEvent *page = getPage(fd >> FD_PAGE_SHIFT);
+  FdEvent *fd_event = &page[fd & (FD_PAGE_SIZE - 1)];
+  fd_event->resetRegistered();
+  return fd_event;
+}
+
+FdEvent *FdEventGroup::getPage(int page_index) {
+  FdEvent *page = m_pages[page_index].load(std::memory_order_acquire);
+  if (page != nullptr) {
+    return page;
+  }
+
+  // 页还不存在，分配一页并尝试发布，竞争失败的线程释放自己分配的页
+  FdEvent *new_page = NewPage(page_index);
+  if (m_pages[page_index].compare_exchange_strong(page, new_page,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
+    return new_page;
+  }
+  DeletePage(new_page);
+  return page;
+}
+
+FdEvent *FdEventGroup::NewPage(int page_index) {
+  FdEvent *page =
+      static_cast<FdEvent *>(::operator new(sizeof(FdEvent) * FD_PAGE_SIZE));
+  int base = page_index << FD_PAGE_SHIFT;
+  for (int i = 0; i < FD_PAGE_SIZE; i++) {
+    new (&page[i]) FdEvent(base + i);
+  }
+  return page;
+}
+
+void FdEventGroup::DeletePage(FdEvent *page) {
+  for (int i = 0; i < FD_PAGE_SIZE; i++) {
+    page[i].~FdEvent();
   }
-  return m_fd_group[fd];
+  ::operator delete(page);
 }
 
-} // namespace rocket
\ No newline at end of file
+} // namespace rocket
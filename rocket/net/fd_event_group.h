@@ -1,27 +1,42 @@
 #ifndef ROCKET_NET_FD_EVENT_GROUP_H
 #define ROCKET_NET_FD_EVENT_GROUP_H
 
-#include "rocket/common/mutex.h"
 #include "rocket/net/fd_event.h"
+#include <atomic>
 #include <memory>
-#include <vector>
 
 namespace rocket {
 
+// fd -> FdEvent 的两级映射表
+// 第一级是固定大小的页指针数组，第二级是按需分配的FdEvent页，
+// 页通过原子指针发布，查找不加锁，扩容时也不会阻塞其他线程
 class FdEventGroup {
 public:
+  static constexpr int FD_PAGE_SHIFT = 10;
+  static constexpr int FD_PAGE_SIZE = 1 << FD_PAGE_SHIFT;  // 每页FdEvent个数
+  static constexpr int MAX_FD_PAGES = 1024;                // 最多支持 1M 个fd
+  static constexpr int MAX_FDS = FD_PAGE_SIZE * MAX_FD_PAGES;
+
   FdEventGroup(int size);
   ~FdEventGroup();
+
+  // 返回新创建的fd对应的FdEvent，fd非法或超出MAX_FDS时返回nullptr。
+  // 同一个fd号之前的使用者关闭fd时不一定从epoll中删除，这里清除留下的注册状态
   FdEvent *getFdEvent(int fd);
 
 public:
   static FdEventGroup *GetFdEventGroup();
 
 private:
-  int m_size{0};
-  std::vector<FdEvent *> m_fd_group;
-  Mutex m_mutex;
+  FdEvent *getPage(int page_index);
+
+  static FdEvent *NewPage(int page_index);
+
+  static void DeletePage(FdEvent *page);
+
+private:
+  std::atomic<FdEvent *> m_pages[MAX_FD_PAGES];
 };
 
 } // namespace rocket
-#endif
\ No newline at end of file
+#endif
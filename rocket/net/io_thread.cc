@@ -35,6 +35,10 @@ void IOThread::start() {
 
 void IOThread::join() { pthread_join(m_thread, nullptr); }
 
+void IOThread::setBusyPoll(int spin_budget_us, int socket_busy_poll_us) {
+  m_event_loop->setBusyPoll(spin_budget_us, socket_busy_poll_us);
+}
+
 void *IOThread::Main(void *arg) {
   IOThread *thread = static_cast<IOThread *>(arg);
   thread->m_event_loop = new EventLoop();
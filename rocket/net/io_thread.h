@@ -17,6 +17,9 @@ public:
 
   void join();
 
+  // 将该IO线程的eventloop切换为忙轮询模式，参数含义见EventLoop::setBusyPoll
+  void setBusyPoll(int spin_budget_us, int socket_busy_poll_us = 0);
+
 public:
   static void *Main(void *arg);
 
@@ -22,6 +22,12 @@ void IOThreadGroup::join() {
   }
 }
 
+void IOThreadGroup::setBusyPoll(int spin_budget_us, int socket_busy_poll_us) {
+  for (auto e : m_io_thread_group) {
+    e->setBusyPoll(spin_budget_us, socket_busy_poll_us);
+  }
+}
+
 IOThread *IOThreadGroup::getIOThread() {
   if (m_index == m_io_thread_group.size()) {
     m_index = 0;
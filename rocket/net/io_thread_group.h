@@ -17,6 +17,13 @@ public:
 
   IOThread *getIOThread();
 
+  const std::vector<IOThread *> &getIOThreads() const {
+    return m_io_thread_group;
+  }
+
+  // 所有IO线程都切换为忙轮询模式
+  void setBusyPoll(int spin_budget_us, int socket_busy_poll_us = 0);
+
 private:
   int m_size{0}; // 线程池中线程的数量
   size_t m_index{0};
@@ -0,0 +1,165 @@
+#include "rocket/net/rpc/concurrency_limiter.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "rocket/common/log.h"
+#include "rocket/common/util.h"
+
+namespace rocket {
+
+// 统计窗口的最短时间和最少样本数，两个条件都满足才调整一次上限
+static const int64_t WINDOW_NS = 100 * 1000 * 1000;
+static const int MIN_WINDOW_SAMPLES = 20;
+
+// 允许窗口延迟超过无负载延迟的倍数，超过后开始缩小上限
+static const double LATENCY_TOLERANCE = 1.5;
+// 无负载延迟取窗口延迟的最小值，每隔这么多个窗口(约30秒)把上限减半一次，
+// 用减半后的延迟重新开始，否则启动时上限过大或者负载长期偏高，
+// 测到的一直是排队后的延迟
+static const int PROBE_INTERVAL_WINDOWS = 300;
+// 每次调整时新上限所占的比重
+static const double SMOOTHING = 0.2;
+
+ConcurrencyLimiter::ConcurrencyLimiter(const std::string &name)
+    : m_name(name) {}
+
+void ConcurrencyLimiter::setPolicy(int max_concurrency, bool is_adaptive) {
+  ScopeMutex<Mutex> lock(m_mutex);
+  // 热加载配置时参数通常没变，不能丢掉已经算出的上限
+  if (max_concurrency == m_max_concurrency &&
+      is_adaptive == m_is_adaptive.load(std::memory_order_relaxed) &&
+      m_window_start_ns.load(std::memory_order_relaxed) != 0) {
+    return;
+  }
+  m_max_concurrency = max_concurrency;
+  m_is_adaptive.store(is_adaptive, std::memory_order_relaxed);
+  if (is_adaptive) {
+    m_max_limit = max_concurrency > 0
+                      ? std::max(max_concurrency, MIN_ADAPTIVE_LIMIT)
+                      : MAX_ADAPTIVE_LIMIT;
+    m_estimated_limit = std::min(INITIAL_ADAPTIVE_LIMIT, m_max_limit);
+    m_noload_latency_ns = 0;
+    m_window_count = 0;
+    m_is_probing = false;
+    m_limit.store(static_cast<int>(m_estimated_limit),
+                  std::memory_order_relaxed);
+  } else {
+    m_limit.store(max_concurrency, std::memory_order_relaxed);
+  }
+  m_window_start_ns.store(getNowNs(), std::memory_order_relaxed);
+  m_window_latency_sum_ns.store(0, std::memory_order_relaxed);
+  m_window_sample_count.store(0, std::memory_order_relaxed);
+  m_window_max_inflight.store(0, std::memory_order_relaxed);
+  m_is_enabled.store(is_adaptive || max_concurrency > 0,
+                     std::memory_order_relaxed);
+}
+
+bool ConcurrencyLimiter::tryAcquire() {
+  int limit = m_limit.load(std::memory_order_relaxed);
+  int inflight = m_inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (limit > 0 && inflight > limit) {
+    m_inflight.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // 自适应模式据此判断上限是否真的被用到，没用到时不放大
+  int max_inflight = m_window_max_inflight.load(std::memory_order_relaxed);
+  while (inflight > max_inflight &&
+         !m_window_max_inflight.compare_exchange_weak(
+             max_inflight, inflight, std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+void ConcurrencyLimiter::release(int64_t latency_ns, bool failed) {
+  m_inflight.fetch_sub(1, std::memory_order_relaxed);
+  if (failed || !m_is_adaptive.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  m_window_latency_sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+  int count =
+      m_window_sample_count.fetch_add(1, std::memory_order_relaxed) + 1;
+  // 每16个样本才读一次时钟
+  if (count < MIN_WINDOW_SAMPLES || count % 16 != 0) {
+    return;
+  }
+  int64_t now = getNowNs();
+  int64_t window_start = m_window_start_ns.load(std::memory_order_relaxed);
+  if (now - window_start < WINDOW_NS ||
+      !m_window_start_ns.compare_exchange_strong(window_start, now,
+                                                 std::memory_order_relaxed)) {
+    return;
+  }
+
+  // 只有抢到窗口的线程取走样本，其他线程的样本计入下一个窗口
+  int64_t sum = m_window_latency_sum_ns.exchange(0, std::memory_order_relaxed);
+  int samples = m_window_sample_count.exchange(0, std::memory_order_relaxed);
+  int max_inflight =
+      m_window_max_inflight.exchange(0, std::memory_order_relaxed);
+  if (samples > 0) {
+    updateLimit(sum / samples, max_inflight);
+  }
+}
+
+void ConcurrencyLimiter::cancel() {
+  m_inflight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConcurrencyLimiter::updateLimit(int64_t avg_latency_ns,
+                                     int max_inflight) {
+  ScopeMutex<Mutex> lock(m_mutex);
+  if (!m_is_adaptive.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  double short_latency =
+      static_cast<double>(std::max<int64_t>(avg_latency_ns, 1));
+  // 探测窗口结束，它的延迟作为新的无负载延迟
+  if (m_noload_latency_ns == 0 || short_latency < m_noload_latency_ns ||
+      m_is_probing) {
+    m_noload_latency_ns = short_latency;
+    m_is_probing = false;
+  }
+
+  // 窗口内并发不到上限的一半，说明是请求量本身少，延迟不能说明上限是否合适
+  if (max_inflight < m_estimated_limit / 2) {
+    return;
+  }
+
+  if (++m_window_count % PROBE_INTERVAL_WINDOWS == 0) {
+    m_is_probing = true;
+    setEstimatedLimit(m_estimated_limit / 2, short_latency, max_inflight);
+    return;
+  }
+
+  // 延迟在容忍范围内时 gradient 为1，上限每次增加约 sqrt(limit)；
+  // 排队使延迟升高时按比例缩小，单次最多减半
+  double gradient = std::max(
+      0.5, std::min(1.0, LATENCY_TOLERANCE * m_noload_latency_ns /
+                             short_latency));
+  double new_limit = m_estimated_limit * gradient + sqrt(m_estimated_limit);
+  new_limit = m_estimated_limit * (1 - SMOOTHING) + new_limit * SMOOTHING;
+  setEstimatedLimit(new_limit, short_latency, max_inflight);
+}
+
+void ConcurrencyLimiter::setEstimatedLimit(double new_limit,
+                                           double short_latency,
+                                           int max_inflight) {
+  new_limit = std::max<double>(MIN_ADAPTIVE_LIMIT,
+                               std::min<double>(m_max_limit, new_limit));
+  if (static_cast<int>(new_limit) != static_cast<int>(m_estimated_limit)) {
+    DEBUGLOG("concurrency limiter [%s] limit %d -> %d, latency %.0f us, "
+             "noload latency %.0f us, max inflight %d%s",
+             m_name.c_str(), static_cast<int>(m_estimated_limit),
+             static_cast<int>(new_limit), short_latency / 1000,
+             m_noload_latency_ns / 1000, max_inflight,
+             m_is_probing ? ", probing" : "");
+  }
+  m_estimated_limit = new_limit;
+  m_limit.store(static_cast<int>(new_limit), std::memory_order_relaxed);
+}
+
+}  // namespace rocket
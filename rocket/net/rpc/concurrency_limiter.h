@@ -0,0 +1,99 @@
+#ifndef ROCKET_NET_RPC_CONCURRENCY_LIMITER_H
+#define ROCKET_NET_RPC_CONCURRENCY_LIMITER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "rocket/common/mutex.h"
+
+namespace rocket {
+
+// 限制同时处理的请求数，超过上限的请求立即拒绝，而不是排队拖慢所有请求。
+// 固定模式下上限就是 max_concurrency；自适应模式下按 Gradient 算法根据延迟
+// 调整上限: 延迟接近无负载延迟时逐步放大，延迟因为排队升高时按比例缩小，
+// 并定期减半上限重新测量无负载延迟，max_concurrency 作为上限的最大值。
+// 所有接口都是线程安全的
+class ConcurrencyLimiter {
+ public:
+  using s_ptr = std::shared_ptr<ConcurrencyLimiter>;
+
+  // 自适应模式下上限的最小值和初始值
+  static constexpr int MIN_ADAPTIVE_LIMIT = 8;
+  static constexpr int INITIAL_ADAPTIVE_LIMIT = 40;
+  // 自适应模式没有配置 max_concurrency 时上限的最大值
+  static constexpr int MAX_ADAPTIVE_LIMIT = 100000;
+
+  ConcurrencyLimiter(const std::string &name);
+
+  // max_concurrency 为0且不是自适应模式时不限制，
+  // 策略有变化时自适应模式重新开始计算上限
+  void setPolicy(int max_concurrency, bool is_adaptive);
+
+  bool isEnabled() const {
+    return m_is_enabled.load(std::memory_order_relaxed);
+  }
+
+  // 申请一个配额，成功时返回true，之后必须调用 release 或 cancel 归还
+  bool tryAcquire();
+
+  // 申请失败的请求真正被拒绝回复时调用，只用于统计
+  void addRejectCount() {
+    m_reject_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // 请求处理完成，latency_ns 是从 tryAcquire 到处理完的时间，
+  // failed 的请求不参与延迟统计
+  void release(int64_t latency_ns, bool failed);
+
+  // 请求没有处理就归还配额，不参与延迟统计
+  void cancel();
+
+  const std::string &getName() const { return m_name; }
+
+  int getLimit() const { return m_limit.load(std::memory_order_relaxed); }
+
+  int getInflight() const {
+    return m_inflight.load(std::memory_order_relaxed);
+  }
+
+  uint64_t getRejectCount() const {
+    return m_reject_count.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // 一个统计窗口结束，按窗口内的平均延迟调整上限
+  void updateLimit(int64_t avg_latency_ns, int max_inflight);
+
+  void setEstimatedLimit(double new_limit, double short_latency,
+                         int max_inflight);
+
+ private:
+  std::string m_name;
+  std::atomic<bool> m_is_enabled{false};
+  std::atomic<bool> m_is_adaptive{false};
+  std::atomic<int> m_limit{0};      // 当前上限，0表示不限制
+  std::atomic<int> m_inflight{0};   // 正在处理的请求数
+  std::atomic<uint64_t> m_reject_count{0};
+
+  // 当前窗口的样本，各个线程无锁累加，窗口结束时由一个线程取走
+  std::atomic<int64_t> m_window_start_ns{0};
+  std::atomic<int64_t> m_window_latency_sum_ns{0};
+  std::atomic<int> m_window_sample_count{0};
+  std::atomic<int> m_window_max_inflight{0};
+
+  // 以下是自适应模式的状态，由 m_mutex 保护
+  Mutex m_mutex;
+  int m_max_concurrency{0};  // setPolicy 设置的参数
+  int m_max_limit{MAX_ADAPTIVE_LIMIT};
+  double m_estimated_limit{INITIAL_ADAPTIVE_LIMIT};
+  double m_noload_latency_ns{0};  // 没有排队时的延迟
+  uint64_t m_window_count{0};
+  bool m_is_probing{false};
+};
+
+}  // namespace rocket
+
+#endif
@@ -7,8 +7,11 @@
 #include "rocket/common/err_code.h"
 #include "rocket/common/log.h"
 #include "rocket/common/msg_util.h"
+#include "rocket/common/runtime.h"
+#include "rocket/common/util.h"
 #include "rocket/net/coder/tinypb_protocol.h"
 #include "rocket/net/rpc/rpc_controller.h"
+#include "rocket/net/rpc/rpc_metrics.h"
 #include "rocket/net/tcp/tcp_client.h"
 #include "rocket/net/timer_event.h"
 
@@ -51,14 +54,18 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
     req_protocol->m_msg_id = my_controller->getMsgId();
   }
   req_protocol->m_method_name = method->full_name();
-  INFOLOG("%s | call method name [%s]", req_protocol->m_msg_id.c_str(),
-          req_protocol->m_method_name.c_str());
+  INFOLOG_RATE(ROCKET_REQUEST_LOG_RATE, "%s | call method name [%s]",
+               req_protocol->m_msg_id.c_str(),
+               req_protocol->m_method_name.c_str());
 
   if (!m_is_init) {
     std::string err_info{"Rpc Channel not init"};
     my_controller->setErrorCode(ERROR_RPC_CHANNEL_INIT, err_info);
     ERRORLOG("%s | %s, origin request [%s]", req_protocol->m_msg_id.c_str(),
              err_info.c_str(), request->ShortDebugString().c_str());
+    if (getClosure()) {
+      getClosure()->Run();
+    }
     return;
   }
 
@@ -69,15 +76,56 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
 
     ERRORLOG("%s | %s, origin request [%s]", req_protocol->m_msg_id.c_str(),
              err_info.c_str(), request->ShortDebugString().c_str());
+    if (getClosure()) {
+      getClosure()->Run();
+    }
     return;
   }
 
   // 获取到当前对象的shared_ptr;
   s_ptr channel = shared_from_this();
 
+  // 在服务端处理请求时发起的调用，回调中沿用该请求的上下文
+  RequestContext::s_ptr context = RequestContext::CopyCurrent();
+
+  // 超时时间不超过当前请求剩余的时间，并随请求发给服务端
+  int64_t remain_ms = 0;
+  if (context != nullptr && context->m_deadline_us != 0) {
+    remain_ms = (context->m_deadline_us - getNowUs()) / 1000;
+    if (remain_ms > 0 && remain_ms < my_controller->getTimeout()) {
+      DEBUGLOG("%s | clamp timeout from %d ms to %ld ms by deadline of [%s]",
+               req_protocol->m_msg_id.c_str(), my_controller->getTimeout(),
+               remain_ms, context->m_msg_id.c_str());
+      my_controller->setTimeout(static_cast<int32_t>(remain_ms));
+    }
+  }
+  req_protocol->m_timeout_ms = my_controller->getTimeout();
+
+  // 超时、连接失败、收到回包时结束统计，先到的生效
+  RpcCallRecorder::s_ptr recorder = std::make_shared<RpcCallRecorder>(
+      RpcMetrics::GetClientMetrics()->getMethodMetrics(method->full_name()),
+      req_protocol->encodedLength());
+
+  // 当前请求的调用方已经超时，不用再发出调用
+  if (context != nullptr && context->m_deadline_us != 0 && remain_ms <= 0) {
+    recorder->finish(0, true);
+    my_controller->setError(ERROR_RPC_DEADLINE_EXCEEDED,
+                            "deadline exceeded before call");
+    ERRORLOG("%s | deadline of [%s] exceeded, skip call method name [%s]",
+             req_protocol->m_msg_id.c_str(), context->m_msg_id.c_str(),
+             req_protocol->m_method_name.c_str());
+    if (getClosure()) {
+      getClosure()->Run();
+    }
+    return;
+  }
+
   // 添加定时任务
   m_timer_event = std::make_shared<TimerEvent>(
-      my_controller->getTimeout(), false, [my_controller, channel]() mutable {
+      my_controller->getTimeout(), false,
+      RequestContext::Wrap(context, [my_controller, channel,
+                                     recorder]() mutable {
+        recorder->finish(0, true);
         my_controller->StartCancel();
         my_controller->setError(
             ERROR_RPC_CALL_TIMEOUT,
@@ -86,14 +134,17 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
           channel->getClosure()->Run();
         }
         channel.reset();
-      });
+      }));
   m_client->addTimerEvent(m_timer_event);
 
-  m_client->connect([req_protocol, channel]() mutable {
+  m_client->connect(RequestContext::Wrap(context, [req_protocol, channel,
+                                                   context,
+                                                   recorder]() mutable {
     RpcController* my_controller =
         dynamic_cast<RpcController*>(channel->getController());
 
     if (channel->getTcpClient()->getConnectErrCode() != 0) {
+      recorder->finish(0, true);
       my_controller->setError(channel->getTcpClient()->getConnectErrCode(),
                               channel->getTcpClient()->getConnectErrInfo());
       ERRORLOG(
@@ -102,14 +153,18 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
           req_protocol->m_msg_id.c_str(), my_controller->getErrorCode(),
           my_controller->getErrorInfo().c_str(),
           channel->getTcpClient()->getPeerAddr()->toString().c_str());
+      channel->getTimerEvent()->setCancel(true);
+      if (!my_controller->IsCanceled() && channel->getClosure()) {
+        channel->getClosure()->Run();
+      }
+      channel.reset();
       return;
     }
 
-    channel->getTcpClient()->writeMessage(req_protocol, [req_protocol, channel,
-                                                         my_controller](
-                                                            AbstractProtocol::
-                                                                s_ptr) mutable {
-      INFOLOG(
+    auto on_write = [req_protocol, channel, my_controller, context,
+                     recorder](AbstractProtocol::s_ptr) mutable {
+      INFOLOG_RATE(
+          ROCKET_REQUEST_LOG_RATE,
           "%s | send request success, call method name [%s], peer address "
           "[%s], local address [%s]",
           req_protocol->m_msg_id.c_str(), req_protocol->m_method_name.c_str(),
@@ -118,10 +173,13 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
 
       channel->getTcpClient()->readMessage(
           req_protocol->m_msg_id,
-          [channel](AbstractProtocol::s_ptr msg) mutable {
+          RequestContext::Wrap(context, [channel, recorder](
+                                            AbstractProtocol::s_ptr
+                                                msg) mutable {
             auto rsp_protocol =
                 std::dynamic_pointer_cast<rocket::TinyPBProtocol>(msg);
-            INFOLOG(
+            INFOLOG_RATE(
+                ROCKET_REQUEST_LOG_RATE,
                 "%s | success get rpc response, call method name [%s], "
                 "peer addr [%s], local addr [%s]",
                 rsp_protocol->m_msg_id.c_str(),
@@ -135,38 +193,42 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
             RpcController* my_controller =
                 dynamic_cast<RpcController*>(channel->getController());
 
-            if (!(channel->getResponse()->ParseFromString(
-                    rsp_protocol->m_pb_data))) {
-              ERRORLOG("%s | serialize error", rsp_protocol->m_msg_id.c_str());
-              my_controller->setErrorCode(ERROR_FAILED_SERIALIZE,
-                                          "serialize error");
-              return;
-            }
-
+            // 服务端返回错误(例如过载被拒绝)和解析失败时也要执行回调，
+            // 调用方才能立即拿到错误
             if (rsp_protocol->m_err_code != 0) {
               ERRORLOG("%s | call rpc failed, error code[%d]. error info [%s]",
                        rsp_protocol->m_msg_id.c_str(), rsp_protocol->m_err_code,
                        rsp_protocol->m_err_info.c_str());
               my_controller->setErrorCode(rsp_protocol->m_err_code,
                                           rsp_protocol->m_err_info);
-              return;
+              recorder->finish(rsp_protocol->m_pk_len, true);
+            } else if (!(channel->getResponse()->ParseFromString(
+                           rsp_protocol->m_pb_data))) {
+              ERRORLOG("%s | serialize error", rsp_protocol->m_msg_id.c_str());
+              my_controller->setErrorCode(ERROR_FAILED_SERIALIZE,
+                                          "serialize error");
+              recorder->finish(rsp_protocol->m_pk_len, true);
+            } else {
+              INFOLOG_RATE(
+                  ROCKET_REQUEST_LOG_RATE,
+                  "%s | call rpc success, call method name [%s], peer "
+                  "addr [%s], local addr [%s]",
+                  rsp_protocol->m_msg_id.c_str(),
+                  rsp_protocol->m_method_name.c_str(),
+                  channel->getTcpClient()->getPeerAddr()->toString().c_str(),
+                  channel->getTcpClient()->getLocalAddr()->toString().c_str());
+              recorder->finish(rsp_protocol->m_pk_len, false);
             }
 
-            INFOLOG(
-                "%s | call rpc success, call method name [%s], peer "
-                "addr [%s], local addr [%s]",
-                rsp_protocol->m_msg_id.c_str(),
-                rsp_protocol->m_method_name.c_str(),
-                channel->getTcpClient()->getPeerAddr()->toString().c_str(),
-                channel->getTcpClient()->getLocalAddr()->toString().c_str());
-
             if (!my_controller->IsCanceled() && channel->getClosure()) {
               channel->getClosure()->Run();
             }
             channel.reset();
-          });
-    });
-  });
+          }));
+    };
+    channel->getTcpClient()->writeMessage(
+        req_protocol, RequestContext::Wrap(context, on_write));
+  }));
 }
 
 google::protobuf::RpcController* RpcChannel::getController() const {
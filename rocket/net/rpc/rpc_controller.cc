@@ -1,7 +1,17 @@
 #include "rocket/net/rpc/rpc_controller.h"
 
+#include <atomic>
+
+#include "rocket/common/config.h"
+
 namespace rocket {
 
+static std::atomic<int32_t> g_default_timeout{1000};  // ms
+
+static ConfigListenerRegistrar g_config_listener([](const Config &config) {
+  RpcController::SetDefaultTimeout(config.m_rpc_timeout);
+});
+
 void RpcController::Reset() {
   m_error_code = 0;
   m_error_info = "";
@@ -10,7 +20,7 @@ void RpcController::Reset() {
   m_is_canceled = false;
   m_local_addr = nullptr;
   m_peer_addr = nullptr;
-  m_timeout = 1000;  // ms
+  m_timeout = GetDefaultTimeout();
 }
 
 bool RpcController::Failed() const { return m_is_failed; }
@@ -59,4 +69,12 @@ NetAddr::s_ptr RpcController::getLocalAddr() const { return m_local_addr; }
 void RpcController::setPeerAddr(NetAddr::s_ptr addr) { m_peer_addr = addr; }
 NetAddr::s_ptr RpcController::getPeerAddr() const { return m_peer_addr; }
 
-}  // namespace rocket
\ No newline at end of file
+void RpcController::SetDefaultTimeout(int32_t timeout) {
+  g_default_timeout.store(timeout, std::memory_order_relaxed);
+}
+
+int32_t RpcController::GetDefaultTimeout() {
+  return g_default_timeout.load(std::memory_order_relaxed);
+}
+
+}  // namespace rocket
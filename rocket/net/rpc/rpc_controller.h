@@ -9,7 +9,7 @@
 namespace rocket {
 class RpcController : public google::protobuf::RpcController {
  public:
-  RpcController(){};
+  RpcController() : m_timeout(GetDefaultTimeout()){};
   ~RpcController(){};
 
   void Reset();
@@ -49,6 +49,11 @@ class RpcController : public google::protobuf::RpcController {
   void setPeerAddr(NetAddr::s_ptr addr);
   NetAddr::s_ptr getPeerAddr() const;
 
+ public:
+  // 新建或Reset的RpcController使用的超时时间(ms)，可通过配置热加载修改
+  static void SetDefaultTimeout(int32_t timeout);
+  static int32_t GetDefaultTimeout();
+
  private:
   int m_error_code{0};
 
@@ -60,7 +65,7 @@ class RpcController : public google::protobuf::RpcController {
   NetAddr::s_ptr m_local_addr;
   NetAddr::s_ptr m_peer_addr;
 
-  int m_timeout{1000};  // ms
+  int m_timeout{0};  // ms
 };
 
 }  // namespace rocket
@@ -1,19 +1,28 @@
 #include "rocket/net/rpc/rpc_dispatcher.h"
 
+#include <algorithm>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
 
+#include "rocket/common/config.h"
 #include "rocket/common/err_code.h"
 #include "rocket/common/log.h"
 #include "rocket/common/runtime.h"
+#include "rocket/common/util.h"
 #include "rocket/net/coder/tinypb_protocol.h"
 #include "rocket/net/rpc/rpc_controller.h"
+#include "rocket/net/rpc/rpc_metrics.h"
 #include "rocket/net/tcp/net_addr.h"
 
 namespace rocket {
 
 static RpcDispatcher* g_rpc_dispatcher = nullptr;
 
+static ConfigListenerRegistrar g_config_listener([](const Config& config) {
+  RpcDispatcher::GetRpcDispatcherInstance()->setServerConcurrency(
+      config.m_max_concurrency, config.m_adaptive_concurrency);
+});
+
 RpcDispatcher* RpcDispatcher::GetRpcDispatcherInstance() {
   if (g_rpc_dispatcher != nullptr) {
     return g_rpc_dispatcher;
@@ -22,14 +31,131 @@ RpcDispatcher* RpcDispatcher::GetRpcDispatcherInstance() {
   return g_rpc_dispatcher;
 }
 
-void RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
+RpcDispatcher::Admission RpcDispatcher::admit(
+    AbstractProtocol::s_ptr request) {
+  Admission admission;
+  if (m_server_limiter.isEnabled()) {
+    if (!m_server_limiter.tryAcquire()) {
+      admission.is_rejected = true;
+      admission.rejected_by = &m_server_limiter;
+      return admission;
+    }
+    admission.server_limiter = &m_server_limiter;
+  }
+
+  // 没有设置过方法的并发上限时不用查找
+  if (m_has_method_limit.load(std::memory_order_relaxed)) {
+    std::shared_ptr<TinyPBProtocol> req_protocol =
+        std::dynamic_pointer_cast<TinyPBProtocol>(request);
+    auto it = m_method_limiters.find(req_protocol->m_method_name);
+    if (it != m_method_limiters.end() && it->second->isEnabled()) {
+      if (!it->second->tryAcquire()) {
+        cancel(admission);
+        admission.is_rejected = true;
+        admission.rejected_by = it->second.get();
+        return admission;
+      }
+      admission.method_limiter = it->second.get();
+    }
+  }
+
+  if (admission.server_limiter || admission.method_limiter) {
+    admission.begin_ns = getNowNs();
+  }
+  return admission;
+}
+
+void RpcDispatcher::cancel(Admission& admission) {
+  if (admission.server_limiter) {
+    admission.server_limiter->cancel();
+    admission.server_limiter = nullptr;
+  }
+  if (admission.method_limiter) {
+    admission.method_limiter->cancel();
+    admission.method_limiter = nullptr;
+  }
+}
+
+bool RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
                              AbstractProtocol::s_ptr response,
-                             TcpConnection* connection) {
+                             TcpConnection* connection,
+                             Admission& admission) {
   std::shared_ptr<TinyPBProtocol> req_protocol =
       std::dynamic_pointer_cast<TinyPBProtocol>(request);
   std::shared_ptr<TinyPBProtocol> rsp_protocol =
       std::dynamic_pointer_cast<TinyPBProtocol>(response);
 
+  // 已注册的方法在 registerService 时创建了统计，其余的都计入 UNKNOWN_METHOD
+  RpcMetrics* metrics = RpcMetrics::GetServerMetrics();
+  MethodMetrics* method_metrics =
+      metrics->getMethodMetrics(req_protocol->m_method_name, false);
+  if (method_metrics == nullptr) {
+    method_metrics = metrics->getMethodMetrics(RpcMetrics::UNKNOWN_METHOD);
+  }
+  RpcCallRecorder recorder(method_metrics, req_protocol->m_pk_len);
+
+  if (admission.is_rejected) {
+    // 被拒绝后没有回复的请求会重新申请，回复时才计入拒绝次数
+    admission.rejected_by->addRejectCount();
+    rsp_protocol->m_msg_id = req_protocol->m_msg_id;
+    rsp_protocol->m_method_name = req_protocol->m_method_name;
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "msg_id %s | reject request of [%s], server overloaded",
+                  req_protocol->m_msg_id.c_str(),
+                  req_protocol->m_method_name.c_str());
+    setTinyPBError(rsp_protocol, ERROR_SERVER_OVERLOADED, "server overloaded");
+  } else if (req_protocol->m_deadline_us != 0 &&
+             getNowUs() >= req_protocol->m_deadline_us) {
+    // 排队期间已经超时，调用方不会再等待结果
+    m_expired_before_call.fetch_add(1, std::memory_order_relaxed);
+    rsp_protocol->m_msg_id = req_protocol->m_msg_id;
+    rsp_protocol->m_method_name = req_protocol->m_method_name;
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "msg_id %s | skip request of [%s], deadline exceeded before "
+                  "call, timeout %d ms",
+                  req_protocol->m_msg_id.c_str(),
+                  req_protocol->m_method_name.c_str(),
+                  req_protocol->m_timeout_ms);
+    setTinyPBError(rsp_protocol, ERROR_RPC_DEADLINE_EXCEEDED,
+                   "deadline exceeded");
+  } else {
+    callMethod(req_protocol, rsp_protocol, connection);
+  }
+
+  bool failed = rsp_protocol->m_err_code != 0;
+  recorder.finish(rsp_protocol->encodedLength(), failed);
+
+  if (admission.server_limiter || admission.method_limiter) {
+    int64_t latency = getNowNs() - admission.begin_ns;
+    if (admission.server_limiter) {
+      admission.server_limiter->release(latency, failed);
+    }
+    if (admission.method_limiter) {
+      admission.method_limiter->release(latency, failed);
+    }
+    admission.server_limiter = nullptr;
+    admission.method_limiter = nullptr;
+  }
+
+  if (req_protocol->m_deadline_us == 0 ||
+      getNowUs() < req_protocol->m_deadline_us) {
+    return true;
+  }
+  if (rsp_protocol->m_err_code != ERROR_RPC_DEADLINE_EXCEEDED) {
+    m_expired_before_response.fetch_add(1, std::memory_order_relaxed);
+    ERRORLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                  "msg_id %s | drop response of [%s], deadline exceeded, "
+                  "timeout %d ms",
+                  req_protocol->m_msg_id.c_str(),
+                  req_protocol->m_method_name.c_str(),
+                  req_protocol->m_timeout_ms);
+  }
+  return false;
+}
+
+void RpcDispatcher::callMethod(std::shared_ptr<TinyPBProtocol> req_protocol,
+                               std::shared_ptr<TinyPBProtocol> rsp_protocol,
+                               TcpConnection* connection) {
   std::string method_full_name = req_protocol->m_method_name;
   std::string service_name{'\0'};
   std::string method_name{'\0'};
@@ -43,6 +169,7 @@ void RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
              rsp_protocol->m_msg_id.c_str(), service_name.c_str());
     setTinyPBError(rsp_protocol, ERROR_PARSE_SERVICE_NAME,
                    "parse_service_name error");
+    return;
   }
   auto it = m_service_map.find(service_name);
   if (it == m_service_map.end()) {
@@ -51,6 +178,7 @@ void RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
              rsp_protocol->m_msg_id.c_str(), service_name.c_str());
     setTinyPBError(rsp_protocol, ERROR_SERVICE_NOT_FOUND,
                    "service not found error");
+    return;
   }
 
   service_s_ptr service = it->second;
@@ -60,13 +188,15 @@ void RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
   if (method == nullptr) {
     // 错误处理
     ERRORLOG("msg_id %s | method %s not found in service [%s]",
-             rsp_protocol->m_msg_id, method_name.c_str(), service_name.c_str());
+             rsp_protocol->m_msg_id.c_str(), method_name.c_str(),
+             service_name.c_str());
     setTinyPBError(rsp_protocol, ERROR_METHOD_NOT_FOUND,
                    "method not found error");
+    return;
   }
 
-  google::protobuf::Message* req_msg =
-      service->GetRequestPrototype(method).New();
+  std::unique_ptr<google::protobuf::Message> req_msg(
+      service->GetRequestPrototype(method).New());
 
   // 反序列化， 将pb_data反序列化为req_msg
   if (!req_msg->ParseFromString(req_protocol->m_pb_data)) {
@@ -74,37 +204,51 @@ void RpcDispatcher::dispatch(AbstractProtocol::s_ptr request,
     ERRORLOG("msg_id %s | deserialized error", rsp_protocol->m_msg_id.c_str(),
              method_name.c_str(), service_name.c_str());
     setTinyPBError(rsp_protocol, ERROR_FAILED_DESERIALIZE, "deserialize error");
+    return;
   }
 
-  INFOLOG("msg_id %s, get rpc request [%s]", req_protocol->m_msg_id.c_str(),
-          req_msg->ShortDebugString().c_str());
+  INFOLOG_RATE(ROCKET_REQUEST_LOG_RATE, "msg_id %s, get rpc request [%s]",
+               req_protocol->m_msg_id.c_str(),
+               req_msg->ShortDebugString().c_str());
 
-  google::protobuf::Message* rsp_msg =
-      service->GetResponsePrototype(method).New();
+  std::unique_ptr<google::protobuf::Message> rsp_msg(
+      service->GetResponsePrototype(method).New());
 
   RpcController rpcController;
   rpcController.setLocalAddr(connection->getLocalAddr());
   rpcController.setPeerAddr(connection->getPeerAddr());
   rpcController.setMsgId(req_protocol->m_msg_id);
+  if (req_protocol->m_deadline_us != 0) {
+    int64_t remain_ms = (req_protocol->m_deadline_us - getNowUs()) / 1000;
+    rpcController.setTimeout(
+        static_cast<int32_t>(std::max<int64_t>(remain_ms, 1)));
+  }
 
-  RunTime::GetRunTime()->m_msg_id = req_protocol->m_msg_id;
-  RunTime::GetRunTime()->m_method_name = method_name;
+  // 请求上下文只在本次调用期间有效，日志和业务代码通过线程局部指针读取
+  RequestContext context;
+  context.m_msg_id = req_protocol->m_msg_id;
+  context.m_method_name = method_name;
+  context.m_peer_addr = connection->getPeerAddr();
+  context.m_local_addr = connection->getLocalAddr();
+  context.m_deadline_us = req_protocol->m_deadline_us;
+  RequestContextGuard context_guard(&context);
 
-  service->CallMethod(method, &rpcController, req_msg, rsp_msg, nullptr);
+  service->CallMethod(method, &rpcController, req_msg.get(), rsp_msg.get(),
+                      nullptr);
 
-  if (rsp_msg->SerializeToString(&rsp_protocol->m_pb_data)) {
+  if (!rsp_msg->SerializeToString(&rsp_protocol->m_pb_data)) {
     ERRORLOG("msg_id %s | serialize error, origin message [%s]",
              rsp_protocol->m_msg_id.c_str(),
              rsp_msg->ShortDebugString().c_str());
     setTinyPBError(rsp_protocol, ERROR_FAILED_SERIALIZE, "serialize error");
+    return;
   }
 
-  // 将错误码设置为0
-  rsp_protocol->m_err_code = 0;
-
-  INFOLOG("msg_id %s | dispath successfully, request [%s], response [%s]",
-          rsp_protocol->m_msg_id.c_str(), req_msg->ShortDebugString().c_str(),
-          rsp_msg->ShortDebugString().c_str());
+  INFOLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+               "msg_id %s | dispath successfully, request [%s], response [%s]",
+               rsp_protocol->m_msg_id.c_str(),
+               req_msg->ShortDebugString().c_str(),
+               rsp_msg->ShortDebugString().c_str());
 }
 
 bool RpcDispatcher::parseServiceFullName(const std::string& full_name,
@@ -121,14 +265,58 @@ bool RpcDispatcher::parseServiceFullName(const std::string& full_name,
   }
   service_name = full_name.substr(0, index);
   method_name = full_name.substr(index + 1, full_name.size() - 1 - index);
-  INFOLOG("parse service_name [%s] and method_name [%s] from full name [%s]",
-          service_name.c_str(), method_name.c_str(), full_name.c_str());
+  INFOLOG_RATE(
+      ROCKET_REQUEST_LOG_RATE,
+      "parse service_name [%s] and method_name [%s] from full name [%s]",
+      service_name.c_str(), method_name.c_str(), full_name.c_str());
   return true;
 }
 
 void RpcDispatcher::registerService(RpcDispatcher::service_s_ptr service) {
   std::string service_name = service->GetDescriptor()->full_name();
   m_service_map[service_name] = service;
+
+  // 只为注册过的方法创建统计，客户端随意传入的方法名不会占用内存
+  const google::protobuf::ServiceDescriptor* descriptor =
+      service->GetDescriptor();
+  for (int i = 0; i < descriptor->method_count(); i++) {
+    std::string method_full_name =
+        service_name + "." + descriptor->method(i)->name();
+    RpcMetrics::GetServerMetrics()->getMethodMetrics(method_full_name);
+    if (m_method_limiters.find(method_full_name) == m_method_limiters.end()) {
+      m_method_limiters[method_full_name] =
+          std::make_shared<ConcurrencyLimiter>(method_full_name);
+    }
+  }
+}
+
+void RpcDispatcher::setServerConcurrency(int max_concurrency,
+                                         bool is_adaptive) {
+  m_server_limiter.setPolicy(max_concurrency, is_adaptive);
+}
+
+bool RpcDispatcher::setMethodConcurrency(const std::string& method_full_name,
+                                         int max_concurrency,
+                                         bool is_adaptive) {
+  auto it = m_method_limiters.find(method_full_name);
+  if (it == m_method_limiters.end()) {
+    ERRORLOG("set concurrency error, method [%s] not registered",
+             method_full_name.c_str());
+    return false;
+  }
+  it->second->setPolicy(max_concurrency, is_adaptive);
+  if (it->second->isEnabled()) {
+    m_has_method_limit.store(true, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+std::vector<ConcurrencyLimiter*> RpcDispatcher::getMethodLimiters() {
+  std::vector<ConcurrencyLimiter*> res;
+  for (auto& e : m_method_limiters) {
+    res.push_back(e.second.get());
+  }
+  return res;
 }
 
 void RpcDispatcher::setTinyPBError(std::shared_ptr<TinyPBProtocol> msg,
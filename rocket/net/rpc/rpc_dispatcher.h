@@ -3,11 +3,14 @@
 
 #include <google/protobuf/service.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "rocket/net/coder/abstract_protocol.h"
+#include "rocket/net/rpc/concurrency_limiter.h"
 #include "rocket/net/tcp/tcp_connection.h"
 
 namespace rocket {
@@ -20,22 +23,76 @@ class RpcDispatcher {
 
   using service_s_ptr = std::shared_ptr<google::protobuf::Service>;
 
-  void dispatch(AbstractProtocol::s_ptr request,
-                AbstractProtocol::s_ptr response, TcpConnection* connection);
+  // 请求占用的并发配额，admit 时申请，dispatch 或 cancel 时归还
+  struct Admission {
+    bool is_rejected{false};
+    ConcurrencyLimiter* rejected_by{nullptr};  // 拒绝请求的 limiter
+    int64_t begin_ns{0};
+    ConcurrencyLimiter* server_limiter{nullptr};  // 为空表示没有占用配额
+    ConcurrencyLimiter* method_limiter{nullptr};
+  };
+
+  // 为收到的请求申请服务端和方法的并发配额，失败时 is_rejected 为true。
+  // 同一批解码出的请求一起申请，后面的请求排队等待的时间也计入并发和延迟
+  Admission admit(AbstractProtocol::s_ptr request);
+
+  // 请求不再处理(例如连接暂停读取)，归还配额
+  void cancel(Admission& admission);
+
+  // 被拒绝的请求直接回复 ERROR_SERVER_OVERLOADED，不调用方法；
+  // 已经超过截止时间的请求不调用方法。返回false表示调用方已经不再等待，
+  // 不需要发送回包
+  bool dispatch(AbstractProtocol::s_ptr request,
+                AbstractProtocol::s_ptr response, TcpConnection* connection,
+                Admission& admission);
 
   void registerService(RpcDispatcher::service_s_ptr service);
 
+  // 整个服务端的并发上限，max_concurrency 为0且不是自适应模式时不限制
+  void setServerConcurrency(int max_concurrency, bool is_adaptive);
+
+  // 单个方法的并发上限，method_full_name 形如 Order.makeOrder，
+  // 需要先注册对应的 service，方法不存在时返回false
+  bool setMethodConcurrency(const std::string& method_full_name,
+                            int max_concurrency, bool is_adaptive);
+
+  ConcurrencyLimiter* getServerLimiter() { return &m_server_limiter; }
+
+  // 所有方法的并发限制，按方法名排序
+  std::vector<ConcurrencyLimiter*> getMethodLimiters();
+
+  // 执行前和回复前发现超过截止时间而丢弃的请求数
+  uint64_t getExpiredBeforeCallCount() const {
+    return m_expired_before_call.load(std::memory_order_relaxed);
+  }
+  uint64_t getExpiredBeforeResponseCount() const {
+    return m_expired_before_response.load(std::memory_order_relaxed);
+  }
+
  private:
   bool parseServiceFullName(const std::string& full_name,
                             std::string& service_name,
                             std::string& method_name);
 
+  // 解析方法名并调用，出错时把错误码写入 rsp_protocol
+  void callMethod(std::shared_ptr<TinyPBProtocol> req_protocol,
+                  std::shared_ptr<TinyPBProtocol> rsp_protocol,
+                  TcpConnection* connection);
+
   void setTinyPBError(std::shared_ptr<TinyPBProtocol> msg, int32_t err_code,
                       const std::string error_info);
 
  private:
   std::map<std::string, std::shared_ptr<google::protobuf::Service>>
       m_service_map;
+
+  ConcurrencyLimiter m_server_limiter{"server"};
+  // key 是 service.method，在 registerService 时创建，之后只读
+  std::map<std::string, ConcurrencyLimiter::s_ptr> m_method_limiters;
+  std::atomic<bool> m_has_method_limit{false};  // 是否有方法设置过并发上限
+
+  std::atomic<uint64_t> m_expired_before_call{0};
+  std::atomic<uint64_t> m_expired_before_response{0};
 };
 
 }  // namespace rocket
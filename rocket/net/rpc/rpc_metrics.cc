@@ -0,0 +1,145 @@
+#include "rocket/net/rpc/rpc_metrics.h"
+
+#include <unordered_map>
+
+#include "rocket/common/util.h"
+
+namespace rocket {
+
+static std::atomic<int> g_next_shard{0};
+
+static thread_local int t_shard_index = -1;
+
+// 每个线程缓存已经查到的 MethodMetrics，正常请求路径上不需要加锁
+static thread_local std::unordered_map<
+    const RpcMetrics *, std::unordered_map<std::string, MethodMetrics *>>
+    t_metrics_cache;
+
+MethodMetrics::MethodMetrics(const std::string &method_name)
+    : m_method_name(method_name) {}
+
+MethodMetrics::Shard &MethodMetrics::currentShard() {
+  if (t_shard_index < 0) {
+    t_shard_index = g_next_shard.fetch_add(1, std::memory_order_relaxed) %
+                    SHARD_COUNT;
+  }
+  return m_shards[t_shard_index];
+}
+
+void MethodMetrics::onRequest(uint64_t request_bytes) {
+  Shard &shard = currentShard();
+  shard.request_count.fetch_add(1, std::memory_order_relaxed);
+  shard.inflight.fetch_add(1, std::memory_order_relaxed);
+  shard.request_bytes.fetch_add(request_bytes, std::memory_order_relaxed);
+}
+
+void MethodMetrics::onResponse(uint64_t latency_ns, uint64_t response_bytes,
+                               bool failed) {
+  // 客户端的回包可能在另一个线程处理，单个分片的 inflight 可能为负，合并后正确
+  Shard &shard = currentShard();
+  shard.inflight.fetch_sub(1, std::memory_order_relaxed);
+  shard.response_bytes.fetch_add(response_bytes, std::memory_order_relaxed);
+  if (failed) {
+    shard.error_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  shard.latency.record(latency_ns);
+}
+
+MethodMetricsSnapshot MethodMetrics::snapshot() const {
+  MethodMetricsSnapshot res;
+  res.method_name = m_method_name;
+  res.latency = std::make_shared<LatencyHistogram>();
+  for (const Shard &shard : m_shards) {
+    res.request_count += shard.request_count.load(std::memory_order_relaxed);
+    res.error_count += shard.error_count.load(std::memory_order_relaxed);
+    res.inflight += shard.inflight.load(std::memory_order_relaxed);
+    res.request_bytes += shard.request_bytes.load(std::memory_order_relaxed);
+    res.response_bytes += shard.response_bytes.load(std::memory_order_relaxed);
+    res.latency->merge(shard.latency);
+  }
+  return res;
+}
+
+void MethodMetrics::reset() {
+  for (Shard &shard : m_shards) {
+    shard.request_count.store(0, std::memory_order_relaxed);
+    shard.error_count.store(0, std::memory_order_relaxed);
+    shard.request_bytes.store(0, std::memory_order_relaxed);
+    shard.response_bytes.store(0, std::memory_order_relaxed);
+    shard.latency.reset();
+  }
+}
+
+RpcCallRecorder::RpcCallRecorder(MethodMetrics *metrics,
+                                 uint64_t request_bytes)
+    : m_metrics(metrics), m_begin_ns(getNowNs()) {
+  m_metrics->onRequest(request_bytes);
+}
+
+RpcCallRecorder::~RpcCallRecorder() { finish(0, true); }
+
+void RpcCallRecorder::finish(uint64_t response_bytes, bool failed) {
+  if (m_finished.exchange(true)) {
+    return;
+  }
+  m_metrics->onResponse(getNowNs() - m_begin_ns, response_bytes, failed);
+}
+
+RpcMetrics *RpcMetrics::GetServerMetrics() {
+  static RpcMetrics *g_server_metrics = new RpcMetrics();
+  return g_server_metrics;
+}
+
+RpcMetrics *RpcMetrics::GetClientMetrics() {
+  static RpcMetrics *g_client_metrics = new RpcMetrics();
+  return g_client_metrics;
+}
+
+MethodMetrics *RpcMetrics::getMethodMetrics(const std::string &method_name,
+                                            bool create /*create = true*/) {
+  auto &cache = t_metrics_cache[this];
+  auto cache_it = cache.find(method_name);
+  if (cache_it != cache.end()) {
+    return cache_it->second;
+  }
+
+  ScopeMutex<Mutex> lock(m_mutex);
+  auto it = m_methods.find(method_name);
+  if (it == m_methods.end()) {
+    if (!create) {
+      return nullptr;
+    }
+    it = m_methods
+             .emplace(method_name, std::make_shared<MethodMetrics>(method_name))
+             .first;
+  }
+  lock.unlock();
+
+  cache[method_name] = it->second.get();
+  return it->second.get();
+}
+
+std::vector<MethodMetricsSnapshot> RpcMetrics::snapshot() const {
+  std::vector<MethodMetrics::s_ptr> methods;
+  ScopeMutex<Mutex> lock(m_mutex);
+  for (auto &e : m_methods) {
+    methods.push_back(e.second);
+  }
+  lock.unlock();
+
+  std::vector<MethodMetricsSnapshot> res;
+  res.reserve(methods.size());
+  for (auto &e : methods) {
+    res.push_back(e->snapshot());
+  }
+  return res;
+}
+
+void RpcMetrics::reset() {
+  ScopeMutex<Mutex> lock(m_mutex);
+  for (auto &e : m_methods) {
+    e.second->reset();
+  }
+}
+
+}  // namespace rocket
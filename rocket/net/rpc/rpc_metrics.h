@@ -0,0 +1,119 @@
+#ifndef ROCKET_NET_RPC_RPC_METRICS_H
+#define ROCKET_NET_RPC_RPC_METRICS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rocket/common/histogram.h"
+#include "rocket/common/mutex.h"
+
+namespace rocket {
+
+// 某个方法在某一时刻的统计数据
+struct MethodMetricsSnapshot {
+  std::string method_name;
+  uint64_t request_count{0};
+  uint64_t error_count{0};
+  int64_t inflight{0};
+  uint64_t request_bytes{0};
+  uint64_t response_bytes{0};
+  // 调用耗时，单位ns
+  LatencyHistogram::s_ptr latency;
+};
+
+// 单个方法的统计。
+// 计数和延迟直方图按线程分片，每个线程固定写自己的分片，避免多个IO线程
+// 争抢同一条缓存行，读取时再把所有分片合并
+class MethodMetrics {
+ public:
+  using s_ptr = std::shared_ptr<MethodMetrics>;
+
+  static constexpr int SHARD_COUNT = 8;
+
+  MethodMetrics(const std::string &method_name);
+
+  // 收到(服务端)或发出(客户端)一个请求
+  void onRequest(uint64_t request_bytes);
+
+  // 请求处理完成，failed 为true时计入错误数
+  void onResponse(uint64_t latency_ns, uint64_t response_bytes, bool failed);
+
+  MethodMetricsSnapshot snapshot() const;
+
+  // 清零累计的计数和直方图，inflight 是当前值，不清零
+  void reset();
+
+  const std::string &getMethodName() const { return m_method_name; }
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> request_count{0};
+    std::atomic<uint64_t> error_count{0};
+    std::atomic<int64_t> inflight{0};
+    std::atomic<uint64_t> request_bytes{0};
+    std::atomic<uint64_t> response_bytes{0};
+    LatencyHistogram latency;
+  };
+
+  Shard &currentShard();
+
+ private:
+  std::string m_method_name;
+  Shard m_shards[SHARD_COUNT];
+};
+
+// 一次调用的统计，构造时计入请求，finish 时计入耗时和结果。
+// 客户端的超时和回包可能先后到达，只有第一次 finish 生效；
+// 没有 finish 就析构的调用按失败统计
+class RpcCallRecorder {
+ public:
+  using s_ptr = std::shared_ptr<RpcCallRecorder>;
+
+  RpcCallRecorder(MethodMetrics *metrics, uint64_t request_bytes);
+
+  ~RpcCallRecorder();
+
+  void finish(uint64_t response_bytes, bool failed);
+
+ private:
+  MethodMetrics *m_metrics{nullptr};
+  int64_t m_begin_ns{0};
+  std::atomic<bool> m_finished{false};
+};
+
+// 按方法名管理 MethodMetrics，服务端和客户端各一份。
+// MethodMetrics 创建后不会删除，返回的指针一直有效
+class RpcMetrics {
+ public:
+  // 服务端收到未注册方法的请求时，统一计入这个名字，防止方法名无限增长
+  static constexpr const char *UNKNOWN_METHOD = "unknown";
+
+  static RpcMetrics *GetServerMetrics();
+
+  static RpcMetrics *GetClientMetrics();
+
+  // 查找方法的统计，不存在时 create 为true则创建，否则返回 nullptr
+  MethodMetrics *getMethodMetrics(const std::string &method_name,
+                                  bool create = true);
+
+  // 按方法名排序的所有方法的统计
+  std::vector<MethodMetricsSnapshot> snapshot() const;
+
+  void reset();
+
+ private:
+  RpcMetrics() = default;
+
+ private:
+  mutable Mutex m_mutex;
+  std::map<std::string, MethodMetrics::s_ptr> m_methods;
+};
+
+}  // namespace rocket
+
+#endif
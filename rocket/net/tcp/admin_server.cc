@@ -0,0 +1,184 @@
+#include "rocket/net/tcp/admin_server.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "rocket/common/log.h"
+
+namespace rocket {
+
+// 请求头的最大长度，超过时返回431
+static const size_t MAX_REQUEST_HEADER_SIZE = 8 * 1024;
+
+// 单次读写的超时时间，防止慢客户端一直占住管理线程
+static const int ADMIN_IO_TIMEOUT_MS = 1000;
+
+AdminServer::AdminServer(NetAddr::s_ptr local_addr)
+    : m_local_addr(local_addr) {}
+
+AdminServer::~AdminServer() { stop(); }
+
+void AdminServer::registerHandler(const std::string &path,
+                                  const std::string &content_type,
+                                  Handler handler) {
+  m_routes[path] = Route{content_type, handler};
+}
+
+bool AdminServer::start() {
+  if (m_is_started) {
+    return true;
+  }
+  if (!m_local_addr->checkValid()) {
+    ERRORLOG("invalid admin addr %s", m_local_addr->toString().c_str());
+    return false;
+  }
+
+  m_listen_fd = socket(m_local_addr->getFamily(), SOCK_STREAM, 0);
+  if (m_listen_fd < 0) {
+    ERRORLOG("admin socket error, errno=%d, error=%s", errno, strerror(errno));
+    return false;
+  }
+  int val = 1;
+  setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+
+  if (bind(m_listen_fd, m_local_addr->getSockAddr(),
+           m_local_addr->getSocklen()) != 0 ||
+      listen(m_listen_fd, 16) != 0) {
+    ERRORLOG("admin server listen on [%s] error, errno=%d, error=%s",
+             m_local_addr->toString().c_str(), errno, strerror(errno));
+    close(m_listen_fd);
+    m_listen_fd = -1;
+    return false;
+  }
+
+  m_is_stop = false;
+  if (pthread_create(&m_thread, NULL, &AdminServer::Main, this) != 0) {
+    ERRORLOG("create admin thread error");
+    close(m_listen_fd);
+    m_listen_fd = -1;
+    return false;
+  }
+  m_is_started = true;
+  INFOLOG("admin server listen success on [%s]",
+          m_local_addr->toString().c_str());
+  return true;
+}
+
+void AdminServer::stop() {
+  if (!m_is_started) {
+    return;
+  }
+  m_is_stop = true;
+  // 关闭监听socket的读端，阻塞中的accept会立即返回
+  shutdown(m_listen_fd, SHUT_RDWR);
+  pthread_join(m_thread, NULL);
+  close(m_listen_fd);
+  m_listen_fd = -1;
+  m_is_started = false;
+}
+
+void *AdminServer::Main(void *arg) {
+  AdminServer *server = static_cast<AdminServer *>(arg);
+  while (!server->m_is_stop) {
+    int fd = accept(server->m_listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED && !server->m_is_stop) {
+        ERRORLOG("admin accept error, errno=%d, error=%s", errno,
+                 strerror(errno));
+        // 避免fd耗尽等持续性错误时空转
+        usleep(100 * 1000);
+      }
+      continue;
+    }
+    server->handleConnection(fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+void AdminServer::handleConnection(int fd) {
+  timeval timeout;
+  timeout.tv_sec = ADMIN_IO_TIMEOUT_MS / 1000;
+  timeout.tv_usec = (ADMIN_IO_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  // 只需要请求行，读到请求头结束即可，忽略body
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    if (request.size() >= MAX_REQUEST_HEADER_SIZE) {
+      sendResponse(fd, 431, "Request Header Fields Too Large", "text/plain",
+                   "request header too large\n");
+      return;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      return;
+    }
+    request.append(buf, n);
+  }
+
+  // 请求行: METHOD SP PATH SP VERSION
+  size_t line_end = request.find("\r\n");
+  std::string line = request.substr(0, line_end);
+  size_t method_end = line.find(' ');
+  size_t path_end = line.find(' ', method_end + 1);
+  if (method_end == std::string::npos || path_end == std::string::npos) {
+    sendResponse(fd, 400, "Bad Request", "text/plain", "bad request\n");
+    return;
+  }
+  std::string method = line.substr(0, method_end);
+  std::string path = line.substr(method_end + 1, path_end - method_end - 1);
+  size_t query = path.find('?');
+  if (query != std::string::npos) {
+    path = path.substr(0, query);
+  }
+
+  if (method != "GET") {
+    sendResponse(fd, 405, "Method Not Allowed", "text/plain",
+                 "only GET is supported\n");
+    return;
+  }
+  auto it = m_routes.find(path);
+  if (it == m_routes.end()) {
+    std::string body = "not found, available paths:\n";
+    for (auto &e : m_routes) {
+      body += e.first + "\n";
+    }
+    sendResponse(fd, 404, "Not Found", "text/plain", body);
+    return;
+  }
+  sendResponse(fd, 200, "OK", it->second.content_type, it->second.handler());
+}
+
+void AdminServer::sendResponse(int fd, int status,
+                               const std::string &status_text,
+                               const std::string &content_type,
+                               const std::string &body) {
+  std::string response = formatString(
+      "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+      "Connection: close\r\n\r\n",
+      status, status_text.c_str(), content_type.c_str(), body.size());
+  response += body;
+
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t n = send(fd, response.data() + sent, response.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ERRORLOG("admin write response error, errno=%d, error=%s", errno,
+               strerror(errno));
+      return;
+    }
+    sent += n;
+  }
+}
+
+}  // namespace rocket
@@ -0,0 +1,62 @@
+#ifndef ROCKET_NET_TCP_ADMIN_SERVER_H
+#define ROCKET_NET_TCP_ADMIN_SERVER_H
+
+#include <pthread.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "rocket/net/tcp/net_addr.h"
+
+namespace rocket {
+
+// 极简的 HTTP/1.1 服务，用于管理和监控(例如 Prometheus 抓取 /metrics)。
+// 在单独的线程里用阻塞IO逐个处理请求，回包后立即关闭连接，不占用IO线程
+class AdminServer {
+ public:
+  using s_ptr = std::shared_ptr<AdminServer>;
+  // 返回响应的body
+  using Handler = std::function<std::string()>;
+
+  AdminServer(NetAddr::s_ptr local_addr);
+
+  ~AdminServer();
+
+  // 注册 GET path 的处理函数，需在start之前调用
+  void registerHandler(const std::string &path, const std::string &content_type,
+                       Handler handler);
+
+  // 监听端口并启动线程，失败时返回false
+  bool start();
+
+  void stop();
+
+ public:
+  static void *Main(void *arg);
+
+ private:
+  void handleConnection(int fd);
+
+  void sendResponse(int fd, int status, const std::string &status_text,
+                    const std::string &content_type, const std::string &body);
+
+ private:
+  struct Route {
+    std::string content_type;
+    Handler handler;
+  };
+
+  NetAddr::s_ptr m_local_addr;
+  int m_listen_fd{-1};
+  pthread_t m_thread{0};
+  bool m_is_started{false};
+  std::atomic<bool> m_is_stop{false};
+  std::map<std::string, Route> m_routes;
+};
+
+}  // namespace rocket
+
+#endif
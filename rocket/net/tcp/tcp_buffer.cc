@@ -1,13 +1,25 @@
 #include "rocket/net/tcp/tcp_buffer.h"
 #include "rocket/common/log.h"
+#include <atomic>
 #include <memory>
 #include <string.h>
 
 namespace rocket {
 
-TcpBuffer::TcpBuffer(int size) : m_size(size) { m_buffer.resize(size); }
+static std::atomic<int64_t> g_total_buffer_bytes{0};
 
-TcpBuffer::~TcpBuffer() {}
+TcpBuffer::TcpBuffer(int size) : m_size(size) {
+  m_buffer.resize(size);
+  g_total_buffer_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+TcpBuffer::~TcpBuffer() {
+  g_total_buffer_bytes.fetch_sub(m_buffer.size(), std::memory_order_relaxed);
+}
+
+int64_t TcpBuffer::GetTotalBufferBytes() {
+  return g_total_buffer_bytes.load(std::memory_order_relaxed);
+}
 
 // 返回可读字节数
 int TcpBuffer::readAble() { return m_write_index - m_read_index; }
@@ -50,6 +62,9 @@ void TcpBuffer::resizeBuffer(int new_size) {
   int count = std::min(new_size, readAble());
 
   memcpy(&tmp[0], &m_buffer[m_read_index], count);
+  g_total_buffer_bytes.fetch_add(static_cast<int64_t>(new_size) -
+                                     static_cast<int64_t>(m_buffer.size()),
+                                 std::memory_order_relaxed);
   m_buffer.swap(tmp);
 
   m_read_index = 0;
@@ -73,7 +88,7 @@ void TcpBuffer::adjustBuffer() {
 
 void TcpBuffer::moveReadIndex(int size) {
   size_t j = m_read_index + size;
-  if (j >= m_buffer.size()) {
+  if (j > m_buffer.size()) {
     ERRORLOG("moveReadIndex error, invalid size %d, old_read_index %d, buffer "
              "size %d",
              size, m_read_index, m_buffer.size());
@@ -85,7 +100,7 @@ void TcpBuffer::moveReadIndex(int size) {
 
 void TcpBuffer::moveWriteIndex(int size) {
   size_t j = m_write_index + size;
-  if (j >= m_buffer.size()) {
+  if (j > m_buffer.size()) {
     ERRORLOG("moveWriteIndex error, invalid size %d, old_read_index %d, buffer "
              "size %d",
              size, m_read_index, m_buffer.size());
@@ -34,6 +34,9 @@ public:
 
   void moveWriteIndex(int offset);
 
+  // 进程内所有TcpBuffer占用的内存(字节)
+  static int64_t GetTotalBufferBytes();
+
 private:
   int m_read_index{0};
   int m_write_index{0};
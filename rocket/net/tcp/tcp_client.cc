@@ -1,5 +1,7 @@
 #include "rocket/net/tcp/tcp_client.h"
 
+#include <unistd.h>
+
 #include <cstring>
 
 #include "rocket/common/err_code.h"
@@ -16,23 +18,45 @@ TcpClient::TcpClient(NetAddr::s_ptr peer_addr) : m_peer_addr(peer_addr) {
 
   if (m_fd < 0) {
     ERRORLOG("TcpClient::TcpClient() error, failed to create fd");
+    m_connect_error_code = ERROR_FAILED_CONNECT;
+    m_connect_error_info =
+        "create socket error, sys error = " + std::string(strerror(errno));
     return;
   }
   m_fd_event = FdEventGroup::GetFdEventGroup()->getFdEvent(m_fd);
+  if (m_fd_event == nullptr) {
+    ERRORLOG("TcpClient::TcpClient() error, no fd_event for fd [%d]", m_fd);
+    m_connect_error_code = ERROR_FAILED_CONNECT;
+    m_connect_error_info = "fd out of range";
+    close(m_fd);
+    m_fd = -1;
+    return;
+  }
   m_fd_event->setNonBlocking();
   m_connection = std::make_shared<TcpConnection>(
-      m_event_loop, m_fd, 128, nullptr, m_peer_addr,
-      TcpConnectionType::TcpConnectionByClient);
+      m_event_loop, m_fd, TcpConnection::GetDefaultBufferSize(), nullptr,
+      m_peer_addr, TcpConnectionType::TcpConnectionByClient);
   m_connection->setTcpConnectionType(TcpConnectionType::TcpConnectionByClient);
 }
 
 TcpClient::~TcpClient() {
   if (m_fd > 0) {
+    // fd关闭后内核会自动将其从epoll中移除
+    if (m_fd_event) {
+      m_fd_event->resetRegistered();
+    }
     close(m_fd);
   }
 }
 
 void TcpClient::connect(std::function<void()> done) {
+  // 构造时创建fd失败，直接以连接失败结束
+  if (m_connection == nullptr) {
+    if (done) {
+      done();
+    }
+    return;
+  }
   int rt =
       ::connect(m_fd, m_peer_addr->getSockAddr(), m_peer_addr->getSocklen());
   if (rt == 0) {
@@ -68,6 +92,7 @@ void TcpClient::connect(std::function<void()> done) {
               ERRORLOG("connect error, errno=%d, error=%s", errno,
                        strerror(errno));
               // 将之前的fd关闭，重新申请一个
+              m_fd_event->resetRegistered();
               close(m_fd);
               m_fd = socket(m_peer_addr->getFamily(), SOCK_STREAM, 0);
             }
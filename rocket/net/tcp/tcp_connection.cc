@@ -1,12 +1,39 @@
 #include "rocket/net/tcp/tcp_connection.h"
 
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cstring>
+
+#include "rocket/common/config.h"
 #include "rocket/common/log.h"
+#include "rocket/common/util.h"
 #include "rocket/net/coder/abstract_protocol.h"
 #include "rocket/net/fd_event_group.h"
 
 namespace rocket {
+static std::atomic<int> g_default_buffer_size{128};
+
+static std::atomic<int> g_high_watermark{0};
+static std::atomic<int> g_low_watermark{0};
+
+static std::atomic<int> g_slow_client_buffer_limit{0};
+static std::atomic<int> g_slow_client_timeout_ms{0};
+static std::atomic<int> g_slow_client_action{SlowClientClose};
+static std::atomic<uint64_t> g_slow_client_closed_count{0};
+static std::atomic<uint64_t> g_slow_client_throttled_count{0};
+
+static ConfigListenerRegistrar g_config_listener([](const Config &config) {
+  TcpConnection::SetDefaultBufferSize(config.m_tcp_buffer_size);
+  TcpConnection::SetOutputWatermark(config.m_output_high_watermark,
+                                    config.m_output_low_watermark);
+  TcpConnection::SetSlowClientPolicy(
+      config.m_slow_client_buffer_limit, config.m_slow_client_timeout,
+      config.m_slow_client_action == "throttle" ? SlowClientThrottle
+                                                : SlowClientClose);
+});
+
 TcpConnection::TcpConnection(
     EventLoop *event_loop, int fd, int buffer_size, NetAddr::s_ptr local_addr,
     NetAddr::s_ptr peer_addr,
@@ -23,14 +50,41 @@ TcpConnection::TcpConnection(
 
   // 获取到fd对应的fd_event
   m_fd_event = FdEventGroup::GetFdEventGroup()->getFdEvent(m_fd);
+  if (m_fd_event == nullptr) {
+    // fd超出范围，连接直接置为Closed，由创建者丢弃
+    ERRORLOG("create TcpConnection error, no fd_event for fd [%d]", m_fd);
+    if (m_connection_type == TcpConnectionType::TcpConnectionByServer &&
+        m_fd >= 0) {
+      close(m_fd);
+    }
+    m_fd = -1;
+    m_state = TcpState::Closed;
+    return;
+  }
 
   // 设置读写为非阻塞
   m_fd_event->setNonBlocking();
 
+  // eventloop处于忙轮询模式时，socket也开启busy poll
+  int busy_poll_us = m_event_loop->getSocketBusyPoll();
+  if (busy_poll_us > 0) {
+    if (setsockopt(m_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                   sizeof(busy_poll_us)) != 0) {
+      ERRORLOG("setsockopt SO_BUSY_POLL error, fd [%d], errno=%d, error=%s",
+               m_fd, errno, strerror(errno));
+    }
+  }
+
   // 初始化编解码器
   m_coder = new TinyPBCoder();
+  m_stats.last_active_ms = getNowMs();
+
+  // 默认在发送缓冲区超过高水位时暂停读取，降到低水位以下后恢复
+  m_high_watermark_callback = [](TcpConnection *conn) { conn->pauseRead(); };
+  m_low_watermark_callback = [](TcpConnection *conn) { conn->resumeRead(); };
 
   if (m_connection_type == TcpConnectionType::TcpConnectionByServer) {
+    m_event_loop->addConnectionCount(1);
     listenRead();
   }
 }
@@ -41,6 +95,11 @@ TcpConnection::~TcpConnection() {
     delete m_coder;
     m_coder = nullptr;
   }
+  // 客户端连接的fd由TcpClient关闭
+  if (m_connection_type == TcpConnectionType::TcpConnectionByServer &&
+      m_fd >= 0) {
+    close(m_fd);
+  }
 }
 
 void TcpConnection::onRead() {
@@ -70,6 +129,7 @@ void TcpConnection::onRead() {
 
     if (rt > 0) {
       m_in_buffer->moveWriteIndex(rt);
+      m_stats.bytes_in += rt;
       if (rt == read_count) {
         continue;
       }
@@ -96,6 +156,7 @@ void TcpConnection::onRead() {
   if (!is_read_all) {
     ERRORLOG("not read all data");
   }
+  m_stats.last_active_ms = getNowMs();
 
   // todo: 简单打印，进行rpc协议的解析
   excute();
@@ -121,9 +182,12 @@ void TcpConnection::onWrite() {
     }
 
     m_coder->encode(messages, m_out_buffer);
+    m_stats.frames_out += messages.size();
   }
 
   bool is_write_all = false;
+  bool is_error = false;
+  uint64_t last_bytes_out = m_stats.bytes_out;
   while (true) {
     if (m_out_buffer->readAble() == 0) {
       DEBUGLOG("no data need to send to client [%s]",
@@ -135,22 +199,47 @@ void TcpConnection::onWrite() {
     int read_index = m_out_buffer->readIndex();
     int rt = ::write(m_fd, &(m_out_buffer->m_buffer[read_index]), write_size);
 
-    std::string s;
-    for (int i = read_index; i < write_size; i++) {
-      s += m_out_buffer->m_buffer[i];
-    }
-
-    if (rt >= write_size) {
-      DEBUGLOG("no data need to send to client [%s]",
-               m_peer_addr->toString().c_str());
-      is_write_all = true;
-      break;
+    if (rt > 0) {
+      // 已发送的数据从out_buffer中移除
+      m_out_buffer->moveReadIndex(rt);
+      m_stats.bytes_out += rt;
+      if (rt >= write_size) {
+        DEBUGLOG("no data need to send to client [%s]",
+                 m_peer_addr->toString().c_str());
+        is_write_all = true;
+        break;
+      }
+      continue;
     }
-    if (rt == -1 && errno == EAGAIN) {
+    if (rt == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
       // 发送缓冲区已经满了，等下次fd可写的时候再发送
-      ERRORLOG("write data error, errno==EAGAIN and rt == -1")
+      DEBUGLOG("socket send buffer is full, %d bytes left, client [%s]",
+               m_out_buffer->readAble(), m_peer_addr->toString().c_str());
       break;
     }
+    if (rt == -1 && errno == EINTR) {
+      continue;
+    }
+    ERRORLOG("write data error, errno=%d, error=%s", errno, strerror(errno));
+    is_error = true;
+    break;
+  }
+
+  int64_t now = getNowMs();
+  if (m_stats.bytes_out != last_bytes_out) {
+    m_stats.last_active_ms = now;
+  }
+  // 还有积压时只要写出了数据就重新计时，持续读取的客户端不会被当作慢客户端
+  if (is_write_all) {
+    m_stats.send_stall_start_ms = 0;
+  } else if (m_stats.bytes_out != last_bytes_out) {
+    m_stats.send_stall_start_ms = now;
+  }
+
+  if (is_error &&
+      m_connection_type == TcpConnectionType::TcpConnectionByServer) {
+    clear();
+    return;
   }
 
   // 如果已经读写完毕
@@ -165,31 +254,98 @@ void TcpConnection::onWrite() {
       e.second(e.first);
     }
     m_write_dones.clear();
+    return;
+  }
+
+  if (!is_write_all && checkSlowClient(now)) {
+    return;
+  }
+  if (m_is_throttled && is_write_all) {
+    INFOLOG("send buffer drained, stop throttling client [%s]",
+            m_peer_addr->toString().c_str());
+    m_is_throttled = false;
+    resumeRead();
+  }
+  int low_watermark = g_low_watermark.load(std::memory_order_relaxed);
+  if (m_is_over_high_watermark && m_out_buffer->readAble() <= low_watermark) {
+    m_is_over_high_watermark = false;
+    DEBUGLOG("send buffer below low watermark, %d bytes queued, client [%s]",
+             m_out_buffer->readAble(), m_peer_addr->toString().c_str());
+    m_low_watermark_callback(this);
   }
 }
 
 // 将rpc执行请求执行业务逻辑，获取rpc响应，再把rpc响应发送出去
 void TcpConnection::excute() {
   if (m_connection_type == TcpConnectionType::TcpConnectionByServer) {
-    std::vector<AbstractProtocol::s_ptr> result;
-    std::vector<AbstractProtocol::s_ptr> responses;
-
-    m_coder->decode(result, m_in_buffer);
-    for (auto &e : result) {
-      INFOLOG("success get request [%s] from client [%s]", e->m_msg_id.c_str(),
-              m_peer_addr->toString().c_str());
-      // 1.针对每一个请求，调用rpc方法，获取响应message
-      // 2. 将响应message放到发送缓冲区，监听可写事件回包
-
-      auto message = std::make_shared<TinyPBProtocol>();
-      // message->m_pb_data = "hello. this is rocket rpc test data";
-      // message->m_msg_id = e->m_msg_id;
+    size_t decoded_count = m_pending_requests.size();
+    m_coder->decode(m_pending_requests, m_in_buffer);
+    m_stats.frames_in += m_pending_requests.size() - decoded_count;
+
+    // 暂停读取时剩下的请求留在 m_pending_requests 中，恢复读取后再处理
+    RpcDispatcher *dispatcher = RpcDispatcher::GetRpcDispatcherInstance();
+    while (!m_pending_requests.empty() && !m_is_read_paused) {
+      // 本轮的请求一起申请并发配额，超过上限的请求会被立即拒绝
+      std::vector<RpcDispatcher::Admission> admissions;
+      admissions.reserve(m_pending_requests.size());
+      for (auto &e : m_pending_requests) {
+        admissions.push_back(dispatcher->admit(e));
+      }
 
-      RpcDispatcher::GetRpcDispatcherInstance()->dispatch(e, message, this);
+      std::vector<AbstractProtocol::s_ptr> responses;
+      int queued = m_out_buffer->readAble();
+      int high_watermark = g_high_watermark.load(std::memory_order_relaxed);
+      bool is_over_high_watermark = false;
+      size_t count = 0;
+      while (count < m_pending_requests.size() && !is_over_high_watermark) {
+        RpcDispatcher::Admission &admission = admissions[count];
+        AbstractProtocol::s_ptr &e = m_pending_requests[count++];
+        INFOLOG_RATE(ROCKET_REQUEST_LOG_RATE,
+                     "success get request [%s] from client [%s]",
+                     e->m_msg_id.c_str(), m_peer_addr->toString().c_str());
+        // 1.针对每一个请求，调用rpc方法，获取响应message
+        // 2. 将响应message放到发送缓冲区，监听可写事件回包
+
+        auto message = std::make_shared<TinyPBProtocol>();
+        // message->m_pb_data = "hello. this is rocket rpc test data";
+        // message->m_msg_id = e->m_msg_id;
+
+        // 调用方已经超时的请求不回包
+        if (!dispatcher->dispatch(e, message, this, admission)) {
+          continue;
+        }
+
+        responses.emplace_back(message);
+        queued += message->encodedLength();
+        is_over_high_watermark = high_watermark > 0 &&
+                                 !m_is_over_high_watermark &&
+                                 queued > high_watermark;
+      }
+      // 没处理的请求归还配额，恢复读取后重新申请
+      for (size_t i = count; i < admissions.size(); i++) {
+        dispatcher->cancel(admissions[i]);
+      }
+      m_pending_requests.erase(m_pending_requests.begin(),
+                               m_pending_requests.begin() + count);
+      if (m_stats.send_stall_start_ms == 0 && !responses.empty()) {
+        m_stats.send_stall_start_ms = getNowMs();
+      }
+      m_coder->encode(responses, m_out_buffer);
+      m_stats.frames_out += responses.size();
+
+      if (is_over_high_watermark) {
+        m_is_over_high_watermark = true;
+        DEBUGLOG("send buffer over high watermark, %d bytes queued, "
+                 "client [%s]",
+                 m_out_buffer->readAble(), m_peer_addr->toString().c_str());
+        m_high_watermark_callback(this);
+      }
+    }
 
-      responses.emplace_back(message);
+    // 对端一直不读时不会再触发可写事件，在这里检查积压
+    if (checkSlowClient(getNowMs())) {
+      return;
     }
-    m_coder->encode(responses, m_out_buffer);
     listenWrite();
 
   } else if (m_connection_type == TcpConnectionType::TcpConnectionByClient) {
@@ -197,6 +353,7 @@ void TcpConnection::excute() {
     std::vector<AbstractProtocol::s_ptr> result;
 
     m_coder->decode(result, m_in_buffer);
+    m_stats.frames_in += result.size();
 
     for (auto e : result) {
       std::string msg_id = e->m_msg_id;
@@ -230,6 +387,9 @@ void TcpConnection::clear() {
            m_peer_addr->toString().c_str());
   // 将连接状态设置为Closed
   m_state = TcpState::Closed;
+  if (m_connection_type == TcpConnectionType::TcpConnectionByServer) {
+    m_event_loop->addConnectionCount(-1);
+  }
 }
 
 // 服务器主动关闭连接
@@ -252,6 +412,9 @@ void TcpConnection::setTcpConnectionType(const TcpConnectionType type) {
 }
 
 void TcpConnection::listenRead() {
+  if (m_fd_event == nullptr) {
+    return;
+  }
   // 为fd的读事件绑定onRead回调函数
   m_fd_event->listen(FdEvent::TriggerEvent::IN_EVENT,
                      std::bind(&TcpConnection::onRead, this));
@@ -260,11 +423,49 @@ void TcpConnection::listenRead() {
 }
 
 void TcpConnection::listenWrite() {
+  if (m_fd_event == nullptr) {
+    return;
+  }
   m_fd_event->listen(FdEvent::TriggerEvent::OUT_EVNET,
                      std::bind(&TcpConnection::onWrite, this));
   m_event_loop->addEpollEvent(m_fd_event);
 }
 
+void TcpConnection::pauseRead() {
+  if (m_is_read_paused || m_state != TcpState::Connected) {
+    return;
+  }
+  m_is_read_paused = true;
+  m_fd_event->cancel(FdEvent::TriggerEvent::IN_EVENT);
+  m_event_loop->addEpollEvent(m_fd_event);
+  DEBUGLOG("pause reading from client [%s], fd [%d]",
+           m_peer_addr->toString().c_str(), m_fd);
+}
+
+void TcpConnection::resumeRead() {
+  if (!m_is_read_paused || m_is_throttled ||
+      m_state != TcpState::Connected) {
+    return;
+  }
+  m_is_read_paused = false;
+  listenRead();
+  DEBUGLOG("resume reading from client [%s], fd [%d]",
+           m_peer_addr->toString().c_str(), m_fd);
+
+  // 暂停前已经收到的请求不会再触发可读事件，需要主动处理
+  if (!m_pending_requests.empty()) {
+    excute();
+  }
+}
+
+void TcpConnection::setHighWatermarkCallback(WatermarkCallback callback) {
+  m_high_watermark_callback = callback;
+}
+
+void TcpConnection::setLowWatermarkCallback(WatermarkCallback callback) {
+  m_low_watermark_callback = callback;
+}
+
 void TcpConnection::pushSendMessage(
     AbstractProtocol::s_ptr message,
     std::function<void(AbstractProtocol::s_ptr)> done) {
@@ -276,4 +477,81 @@ void TcpConnection::pushReadMessage(
     std::function<void(AbstractProtocol::s_ptr)> done) {
   m_read_dones.insert(std::make_pair(msg_id, done));
 }
+
+void TcpConnection::SetDefaultBufferSize(int buffer_size) {
+  g_default_buffer_size.store(buffer_size, std::memory_order_relaxed);
+}
+
+int TcpConnection::GetDefaultBufferSize() {
+  return g_default_buffer_size.load(std::memory_order_relaxed);
+}
+
+void TcpConnection::SetOutputWatermark(int high_watermark, int low_watermark) {
+  g_high_watermark.store(high_watermark, std::memory_order_relaxed);
+  g_low_watermark.store(low_watermark, std::memory_order_relaxed);
+}
+
+int64_t TcpConnection::getSendStallMs(int64_t now_ms) const {
+  if (m_stats.send_stall_start_ms == 0) {
+    return 0;
+  }
+  return now_ms - m_stats.send_stall_start_ms;
+}
+
+bool TcpConnection::checkSlowClient(int64_t now_ms) {
+  if (m_state != TcpState::Connected || m_is_throttled) {
+    return false;
+  }
+  int buffer_limit = g_slow_client_buffer_limit.load(std::memory_order_relaxed);
+  int timeout_ms = g_slow_client_timeout_ms.load(std::memory_order_relaxed);
+  if (buffer_limit > 0 && m_out_buffer->readAble() > buffer_limit) {
+    onSlowClient("send buffer over limit");
+    return true;
+  }
+  if (timeout_ms > 0 && getSendStallMs(now_ms) > timeout_ms) {
+    onSlowClient("send stalled too long");
+    return true;
+  }
+  return false;
+}
+
+void TcpConnection::onSlowClient(const char *reason) {
+  int action = g_slow_client_action.load(std::memory_order_relaxed);
+  ERRORLOG("slow client [%s], fd [%d], %s, %d bytes queued, stalled %ld ms, "
+           "%s",
+           m_peer_addr->toString().c_str(), m_fd, reason,
+           m_out_buffer->readAble(), getSendStallMs(getNowMs()),
+           action == SlowClientThrottle ? "stop reading" : "close connection");
+
+  if (action == SlowClientThrottle) {
+    g_slow_client_throttled_count.fetch_add(1, std::memory_order_relaxed);
+    // 有积压时一直在监听写事件，积压的响应全部发完后才恢复读取
+    m_is_throttled = true;
+    pauseRead();
+    return;
+  }
+
+  g_slow_client_closed_count.fetch_add(1, std::memory_order_relaxed);
+  // 积压的响应直接丢弃，fd关闭时发送RST，不在内核中继续等待对端读取
+  linger lin;
+  lin.l_onoff = 1;
+  lin.l_linger = 0;
+  setsockopt(m_fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+  ::shutdown(m_fd, SHUT_RDWR);
+  clear();
+}
+
+void TcpConnection::SetSlowClientPolicy(int buffer_limit, int timeout_ms,
+                                        SlowClientAction action) {
+  g_slow_client_buffer_limit.store(buffer_limit, std::memory_order_relaxed);
+  g_slow_client_timeout_ms.store(timeout_ms, std::memory_order_relaxed);
+  g_slow_client_action.store(action, std::memory_order_relaxed);
+}
+
+uint64_t TcpConnection::GetSlowClientCount(SlowClientAction action) {
+  if (action == SlowClientThrottle) {
+    return g_slow_client_throttled_count.load(std::memory_order_relaxed);
+  }
+  return g_slow_client_closed_count.load(std::memory_order_relaxed);
+}
 }  // namespace rocket
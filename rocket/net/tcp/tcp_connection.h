@@ -1,6 +1,9 @@
 #ifndef ROCKET_NET_TCP_TCP_CONNECTION_H
 #define ROCKET_NET_TCP_TCP_CONNECTION_H
 
+#include <stdint.h>
+
+#include <functional>
 #include <map>
 #include <memory>
 #include <queue>
@@ -28,11 +31,28 @@ enum TcpConnectionType {
   TcpConnectionByClient = 2,  // 作为客户端使用，代表跟对端服务端连接
 };
 
+// 发现慢客户端后的处理方式
+enum SlowClientAction {
+  SlowClientClose = 1,     // 关闭连接
+  SlowClientThrottle = 2,  // 暂停读取该连接的请求，发送缓冲区清空后恢复
+};
+
+// 连接的统计信息，只在连接所在的IO线程中读写
+struct TcpConnectionStats {
+  uint64_t bytes_in{0};            // 从socket读到的字节数
+  uint64_t bytes_out{0};           // 写入socket的字节数
+  uint64_t frames_in{0};           // 解码出的包数
+  uint64_t frames_out{0};          // 编码发出的包数
+  int64_t last_active_ms{0};       // 最近一次读到或写出数据的时间
+  int64_t send_stall_start_ms{0};  // 积压期间最近一次写出数据的时间，0表示已经发完
+};
+
 class RpcDispatcher;
 
 class TcpConnection {
  public:
   using s_ptr = std::shared_ptr<TcpConnection>;
+  using WatermarkCallback = std::function<void(TcpConnection *)>;
 
   TcpConnection(
       EventLoop *event_loop, int fd, int buffer_size, NetAddr::s_ptr local_addr,
@@ -74,6 +94,58 @@ class TcpConnection {
   NetAddr::s_ptr getLocalAddr() const { return m_local_addr; };
   NetAddr::s_ptr getPeerAddr() const { return m_peer_addr; };
 
+  EventLoop *getEventLoop() const { return m_event_loop; }
+
+  int getFd() const { return m_fd; }
+
+  // 以下接口只能在连接所在的IO线程中调用
+  const TcpConnectionStats &getStats() const { return m_stats; }
+
+  // 发送缓冲区中还没写入socket的字节数
+  int getOutputBytes() const { return m_out_buffer->readAble(); }
+
+  // 发送缓冲区有积压且没有写出任何数据的时间(ms)，没有积压时为0
+  int64_t getSendStallMs(int64_t now_ms) const;
+
+  // 是否因为慢客户端暂停了读取
+  bool isThrottled() const { return m_is_throttled; }
+
+  // 暂停读取和处理该连接的请求，已经解码的请求留到恢复后处理
+  void pauseRead();
+
+  // 恢复读取，慢客户端被限流时要等积压的响应全部发完
+  void resumeRead();
+
+  bool isReadPaused() const { return m_is_read_paused; }
+
+  // 服务端连接的发送缓冲区超过高水位时调用，默认暂停读取(pauseRead)
+  void setHighWatermarkCallback(WatermarkCallback callback);
+
+  // 超过高水位后降到低水位及以下时调用，默认恢复读取(resumeRead)
+  void setLowWatermarkCallback(WatermarkCallback callback);
+
+  // 检查是否为慢客户端，是则按配置关闭连接或暂停读取，返回是否为慢客户端
+  bool checkSlowClient(int64_t now_ms);
+
+ public:
+  // 新连接读写缓冲区的初始大小，修改后只对之后建立的连接生效
+  static void SetDefaultBufferSize(int buffer_size);
+  static int GetDefaultBufferSize();
+
+  // 服务端连接发送缓冲区的高低水位(字节)，high_watermark为0表示不限制
+  static void SetOutputWatermark(int high_watermark, int low_watermark);
+
+  // 慢客户端的判定条件: 发送缓冲区积压超过 buffer_limit 字节，
+  // 或者有积压时超过 timeout_ms 没有写出任何数据，0表示不检查该条件
+  static void SetSlowClientPolicy(int buffer_limit, int timeout_ms,
+                                  SlowClientAction action);
+
+  // 发现的慢客户端数量
+  static uint64_t GetSlowClientCount(SlowClientAction action);
+
+ private:
+  void onSlowClient(const char *reason);
+
  private:
   EventLoop *m_event_loop{nullptr};  // 对应的event_loop
 
@@ -89,6 +161,17 @@ class TcpConnection {
   TcpConnectionType m_connection_type;  // 标识tcpConnection的类型
   AbstractCoder *m_coder{nullptr};      // 编解码器
 
+  TcpConnectionStats m_stats;   // 连接的统计信息
+  bool m_is_throttled{false};  // 是否因为慢客户端暂停了读取
+  bool m_is_read_paused{false};          // 是否暂停了读取
+  bool m_is_over_high_watermark{false};  // 发送缓冲区是否超过了高水位
+
+  WatermarkCallback m_high_watermark_callback;
+  WatermarkCallback m_low_watermark_callback;
+
+  // 已经解码、因为暂停读取还没有处理的请求
+  std::vector<AbstractProtocol::s_ptr> m_pending_requests;
+
   std::vector<std::pair<AbstractProtocol::s_ptr,
                         std::function<void(AbstractProtocol::s_ptr)>>>
       m_write_dones;
@@ -1,18 +1,34 @@
 #include "rocket/net/tcp/tcp_server.h"
 
+#include <algorithm>
+#include <map>
 #include <string>
 
+#include "rocket/common/config.h"
 #include "rocket/common/log.h"
+#include "rocket/common/util.h"
+#include "rocket/net/eventloop_watchdog.h"
+#include "rocket/net/rpc/rpc_dispatcher.h"
+#include "rocket/net/rpc/rpc_metrics.h"
+#include "rocket/net/tcp/tcp_buffer.h"
 #include "rocket/net/tcp/tcp_connection.h"
 
 namespace rocket {
+
+// 检查连接的间隔，慢客户端的积压超时按这个粒度判定
+static const int CONNECTION_SWEEP_INTERVAL_MS = 1000;
+
 TcpServer::TcpServer(NetAddr::s_ptr local_addr) : m_local_addr(local_addr) {
   init();
   INFOLOG("rocket TcpServer listen success on [%s]",
           m_local_addr->toString().c_str());
 }
 
-TcpServer::~TcpServer() {}
+TcpServer::~TcpServer() {
+  if (m_admin_server) {
+    m_admin_server->stop();
+  }
+}
 
 // 进行server的初始化
 void TcpServer::init() {
@@ -22,8 +38,17 @@ void TcpServer::init() {
   // 获取到主线程的eventloop
   m_main_eventloop = EventLoop::GetCurrentEventLoop();
 
-  // 创建io线程组
-  m_io_thread_group = new IOThreadGroup(2);
+  // 按配置创建io线程组，没有加载配置时使用默认配置
+  Config default_config;
+  Config *config = Config::GetGlobalConfig();
+  if (config == nullptr) {
+    config = &default_config;
+  }
+  m_io_thread_group = new IOThreadGroup(config->m_io_threads);
+  if (config->m_busy_poll_us > 0) {
+    m_io_thread_group->setBusyPoll(config->m_busy_poll_us,
+                                   config->m_socket_busy_poll_us);
+  }
 
   // 获取到listenfd event
   m_listen_fd_event = new FdEvent(m_accepter->getFdEvent());
@@ -33,6 +58,11 @@ void TcpServer::init() {
                             std::bind(&TcpServer::onAccept, this));
   // 将该listen_fd_event添加到主线程的eventloop中
   m_main_eventloop->addEpollEvent(m_listen_fd_event);
+
+  m_connection_snapshots.resize(m_io_thread_group->getIOThreads().size());
+  m_sweep_timer_event = std::make_shared<TimerEvent>(
+      CONNECTION_SWEEP_INTERVAL_MS, true, std::bind(&TcpServer::onSweep, this));
+  m_main_eventloop->addTimerEvent(m_sweep_timer_event);
 }
 
 void TcpServer::onAccept() {
@@ -43,15 +73,22 @@ void TcpServer::onAccept() {
   int client_fd = result.first;
   NetAddr::s_ptr peer_addr = result.second;
 
-  // client数量++
-  m_client_counts++;
-
   // 把clientfd添加到任意一个io线程中
   IOThread *io_thread = m_io_thread_group->getIOThread();
 
   // 为client建立新连接
   TcpConnection::s_ptr connection = std::make_shared<TcpConnection>(
-      io_thread->getEventLoop(), client_fd, 128, m_local_addr, peer_addr);
+      io_thread->getEventLoop(), client_fd,
+      TcpConnection::GetDefaultBufferSize(), m_local_addr, peer_addr);
+
+  // fd无法使用时连接在构造时已经关闭
+  if (connection->getState() == TcpState::Closed) {
+    ERRORLOG("TcpServer drop client, fd=%d", client_fd);
+    return;
+  }
+
+  // client数量++
+  m_client_counts++;
 
   // 设置建立的连接为Connected
   connection->setState(TcpState::Connected);
@@ -62,12 +99,439 @@ void TcpServer::onAccept() {
   INFOLOG("TcpServer success get client, fd=%d", client_fd);
 }
 
+void TcpServer::onSweep() {
+  // 连接的状态和统计只能在所属的IO线程中访问，按loop分组后交给各个线程
+  const std::vector<IOThread *> &io_threads = m_io_thread_group->getIOThreads();
+  std::map<EventLoop *, std::vector<TcpConnection::s_ptr>> groups;
+  for (auto &connection : m_clients) {
+    groups[connection->getEventLoop()].push_back(connection);
+  }
+  for (size_t i = 0; i < io_threads.size(); i++) {
+    EventLoop *event_loop = io_threads[i]->getEventLoop();
+    std::vector<TcpConnection::s_ptr> connections;
+    connections.swap(groups[event_loop]);
+    event_loop->addTask(
+        [this, i, connections]() {
+          sweepConnections(static_cast<int>(i), connections);
+        },
+        true);
+  }
+}
+
+void TcpServer::sweepConnections(
+    int loop_index, const std::vector<TcpConnection::s_ptr> &connections) {
+  int64_t now = getNowMs();
+  std::vector<ConnectionSnapshot> snapshots;
+  std::vector<TcpConnection::s_ptr> closed;
+  for (auto &connection : connections) {
+    if (connection->getState() == TcpState::Connected) {
+      connection->checkSlowClient(now);
+    }
+    if (connection->getState() == TcpState::Closed) {
+      closed.push_back(connection);
+      continue;
+    }
+    ConnectionSnapshot snapshot;
+    snapshot.peer_addr = connection->getPeerAddr()->toString();
+    snapshot.fd = connection->getFd();
+    snapshot.stats = connection->getStats();
+    snapshot.output_bytes = connection->getOutputBytes();
+    snapshot.idle_ms = now - snapshot.stats.last_active_ms;
+    snapshot.stall_ms = connection->getSendStallMs(now);
+    snapshot.is_throttled = connection->isThrottled();
+    snapshot.is_read_paused = connection->isReadPaused();
+    snapshots.push_back(snapshot);
+  }
+
+  ScopeMutex<Mutex> lock(m_metrics_mutex);
+  m_connection_snapshots[loop_index].swap(snapshots);
+  lock.unlock();
+
+  if (!closed.empty()) {
+    // IO线程的任务队列中可能还有绑定了连接裸指针的回调，连接必须回到所属loop
+    // 等这些任务执行完再析构，否则析构时关闭的fd可能已被复用。
+    // 连接已从epoll中删除，之后不会再产生它的回调
+    EventLoop *event_loop = closed.front()->getEventLoop();
+    m_main_eventloop->addTask(
+        [this, event_loop, closed = std::move(closed)]() mutable {
+          // IO线程落后时相邻两次检查可能报告同一个连接
+          for (auto &connection : closed) {
+            if (m_clients.erase(connection)) {
+              m_client_counts--;
+            }
+          }
+          DEBUGLOG("remove %zu closed connections, %zu left", closed.size(),
+                   m_clients.size());
+          // 转移引用，保证最后一次释放发生在IO线程
+          event_loop->addTask([closed = std::move(closed)]() {}, true);
+        },
+        true);
+  }
+}
+
+void TcpServer::setBusyPoll(int spin_budget_us, int socket_busy_poll_us) {
+  m_io_thread_group->setBusyPoll(spin_budget_us, socket_busy_poll_us);
+}
+
+void TcpServer::enableAdmin(NetAddr::s_ptr admin_addr) {
+  m_admin_server = std::make_shared<AdminServer>(admin_addr);
+  m_admin_server->registerHandler(
+      "/metrics", "text/plain; version=0.0.4",
+      std::bind(&TcpServer::dumpMetrics, this));
+  m_admin_server->registerHandler(
+      "/connections", "text/plain",
+      std::bind(&TcpServer::dumpConnections, this));
+}
+
 void TcpServer::start() {
   // 线程组启动
   m_io_thread_group->start();
 
+  // 管理接口只用于本机的采集程序，默认只监听回环地址
+  Config *config = Config::GetGlobalConfig();
+  if (!m_admin_server && config != nullptr && config->m_admin_port > 0) {
+    enableAdmin(
+        std::make_shared<IPNetAddr>("127.0.0.1", config->m_admin_port));
+  }
+  if (m_admin_server) {
+    m_admin_server->start();
+  }
+
+  // 在主线程中定时检查配置文件的修改
+  int reload_interval = Config::EnableHotReload();
+  if (reload_interval > 0) {
+    m_main_eventloop->addTimerEvent(std::make_shared<TimerEvent>(
+        reload_interval, true, &Config::CheckReload));
+  }
+
   // 主线程的loop开始
   m_main_eventloop->loop();
 }
 
+// Prometheus 标签值中的 \、" 和换行需要转义
+static std::string EscapeLabelValue(const std::string &value) {
+  std::string res;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      res += '\\';
+      res += c;
+    } else if (c == '\n') {
+      res += "\\n";
+    } else {
+      res += c;
+    }
+  }
+  return res;
+}
+
+static void AppendHeader(std::string &out, const char *name, const char *type,
+                         const char *help) {
+  out += formatString("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// 把ns为单位的直方图输出为以秒为单位的 summary，label 形如 method="xxx"
+static void AppendSummary(std::string &out, const std::string &name,
+                          const std::string &label,
+                          const LatencyHistogram &histogram) {
+  static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  for (double q : quantiles) {
+    out += formatString("%s{%s,quantile=\"%g\"} %.9f\n", name.c_str(),
+                        label.c_str(), q, histogram.percentile(q * 100) / 1e9);
+  }
+  out += formatString("%s_sum{%s} %.9f\n", name.c_str(), label.c_str(),
+                      histogram.sum() / 1e9);
+  out += formatString("%s_count{%s} %lu\n", name.c_str(), label.c_str(),
+                      histogram.count());
+}
+
+static void AppendRpcMetrics(std::string &out, const char *side,
+                             RpcMetrics *metrics) {
+  std::vector<MethodMetricsSnapshot> snapshots = metrics->snapshot();
+  if (snapshots.empty()) {
+    return;
+  }
+  std::string prefix = formatString("rocket_rpc_%s", side);
+
+  struct Counter {
+    const char *suffix;
+    const char *type;
+    const char *help;
+    double (*value)(const MethodMetricsSnapshot &);
+  };
+  static const Counter counters[] = {
+      {"requests_total", "counter", "RPC requests.",
+       [](const MethodMetricsSnapshot &e) {
+         return static_cast<double>(e.request_count);
+       }},
+      {"errors_total", "counter", "RPC requests finished with an error.",
+       [](const MethodMetricsSnapshot &e) {
+         return static_cast<double>(e.error_count);
+       }},
+      {"inflight", "gauge", "RPC requests in progress.",
+       [](const MethodMetricsSnapshot &e) {
+         return static_cast<double>(e.inflight);
+       }},
+      {"request_bytes_total", "counter", "Encoded request bytes.",
+       [](const MethodMetricsSnapshot &e) {
+         return static_cast<double>(e.request_bytes);
+       }},
+      {"response_bytes_total", "counter", "Encoded response bytes.",
+       [](const MethodMetricsSnapshot &e) {
+         return static_cast<double>(e.response_bytes);
+       }},
+  };
+  for (const Counter &counter : counters) {
+    std::string name = prefix + "_" + counter.suffix;
+    AppendHeader(out, name.c_str(), counter.type, counter.help);
+    for (auto &e : snapshots) {
+      out += formatString("%s{method=\"%s\"} %.0f\n", name.c_str(),
+                          EscapeLabelValue(e.method_name).c_str(),
+                          counter.value(e));
+    }
+  }
+
+  std::string name = prefix + "_latency_seconds";
+  AppendHeader(out, name.c_str(), "summary", "RPC latency.");
+  for (auto &e : snapshots) {
+    AppendSummary(out, name,
+                  "method=\"" + EscapeLabelValue(e.method_name) + "\"",
+                  *e.latency);
+  }
+}
+
+// 服务端和设置了上限的各个方法的并发限制
+static void AppendConcurrencyMetrics(std::string &out) {
+  RpcDispatcher *dispatcher = RpcDispatcher::GetRpcDispatcherInstance();
+  std::vector<ConcurrencyLimiter *> limiters{dispatcher->getServerLimiter()};
+  for (ConcurrencyLimiter *limiter : dispatcher->getMethodLimiters()) {
+    if (limiter->isEnabled()) {
+      limiters.push_back(limiter);
+    }
+  }
+
+  AppendHeader(out, "rocket_rpc_server_concurrency_limit", "gauge",
+               "Max requests handled at the same time, 0 means unlimited.");
+  for (ConcurrencyLimiter *limiter : limiters) {
+    out += formatString("rocket_rpc_server_concurrency_limit{limiter=\"%s\"} "
+                        "%d\n",
+                        EscapeLabelValue(limiter->getName()).c_str(),
+                        limiter->isEnabled() ? limiter->getLimit() : 0);
+  }
+
+  AppendHeader(out, "rocket_rpc_server_concurrency_inflight", "gauge",
+               "Admitted requests not answered yet, including queued ones.");
+  for (ConcurrencyLimiter *limiter : limiters) {
+    out += formatString(
+        "rocket_rpc_server_concurrency_inflight{limiter=\"%s\"} %d\n",
+        EscapeLabelValue(limiter->getName()).c_str(), limiter->getInflight());
+  }
+
+  AppendHeader(out, "rocket_rpc_server_rejected_total", "counter",
+               "Requests rejected by the concurrency limit.");
+  for (ConcurrencyLimiter *limiter : limiters) {
+    out += formatString("rocket_rpc_server_rejected_total{limiter=\"%s\"} "
+                        "%lu\n",
+                        EscapeLabelValue(limiter->getName()).c_str(),
+                        limiter->getRejectCount());
+  }
+}
+
+std::string TcpServer::dumpMetrics() {
+  // 主线程的loop只负责accept，其余是IO线程
+  std::vector<std::string> names{"main"};
+  std::vector<EventLoop *> loops{m_main_eventloop};
+  const std::vector<IOThread *> &io_threads = m_io_thread_group->getIOThreads();
+  for (size_t i = 0; i < io_threads.size(); i++) {
+    names.push_back(formatString("io%zu", i));
+    loops.push_back(io_threads[i]->getEventLoop());
+  }
+
+  std::vector<EpollStats> stats;
+  for (EventLoop *loop : loops) {
+    stats.push_back(loop->getEpollStats());
+  }
+
+  // 忙碌比例按两次dump之间的增量计算
+  ScopeMutex<Mutex> lock(m_metrics_mutex);
+  std::vector<EpollStats> last_stats = m_last_loop_stats;
+  m_last_loop_stats = stats;
+  // 各IO线程中连接的发送积压和被暂停读取的连接数
+  std::vector<int64_t> queued_bytes{0};
+  std::vector<int> throttled{0};
+  std::vector<int> read_paused{0};
+  for (auto &snapshots : m_connection_snapshots) {
+    queued_bytes.push_back(0);
+    throttled.push_back(0);
+    read_paused.push_back(0);
+    for (auto &e : snapshots) {
+      queued_bytes.back() += e.output_bytes;
+      throttled.back() += e.is_throttled ? 1 : 0;
+      read_paused.back() += e.is_read_paused ? 1 : 0;
+    }
+  }
+  lock.unlock();
+  queued_bytes.resize(loops.size());
+  throttled.resize(loops.size());
+  read_paused.resize(loops.size());
+  last_stats.resize(stats.size());
+
+  std::string out;
+  AppendHeader(out, "rocket_connections", "gauge",
+               "Server connections handled by each loop.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_connections{loop=\"%s\"} %d\n",
+                        names[i].c_str(), loops[i]->getConnectionCount());
+  }
+
+  AppendHeader(out, "rocket_connection_queued_bytes", "gauge",
+               "Response bytes waiting to be written to sockets.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_connection_queued_bytes{loop=\"%s\"} %ld\n",
+                        names[i].c_str(), queued_bytes[i]);
+  }
+
+  AppendHeader(out, "rocket_connections_throttled", "gauge",
+               "Slow clients whose requests are not read until they catch up.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_connections_throttled{loop=\"%s\"} %d\n",
+                        names[i].c_str(), throttled[i]);
+  }
+
+  AppendHeader(out, "rocket_connections_read_paused", "gauge",
+               "Connections not being read, over the output high watermark "
+               "or throttled.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_connections_read_paused{loop=\"%s\"} %d\n",
+                        names[i].c_str(), read_paused[i]);
+  }
+
+  AppendHeader(out, "rocket_slow_clients_total", "counter",
+               "Slow clients detected, by the action taken.");
+  out += formatString("rocket_slow_clients_total{action=\"close\"} %lu\n",
+                      TcpConnection::GetSlowClientCount(SlowClientClose));
+  out += formatString("rocket_slow_clients_total{action=\"throttle\"} %lu\n",
+                      TcpConnection::GetSlowClientCount(SlowClientThrottle));
+
+  AppendHeader(out, "rocket_eventloop_busy_ratio", "gauge",
+               "Share of time spent outside epoll_wait since the last scrape.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    uint64_t busy = stats[i].busy_ns - last_stats[i].busy_ns;
+    uint64_t wait = stats[i].wait_ns - last_stats[i].wait_ns;
+    out += formatString("rocket_eventloop_busy_ratio{loop=\"%s\"} %.4f\n",
+                        names[i].c_str(),
+                        busy + wait > 0
+                            ? static_cast<double>(busy) / (busy + wait)
+                            : 0.0);
+  }
+
+  AppendHeader(out, "rocket_eventloop_busy_seconds_total", "counter",
+               "Time spent outside epoll_wait.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString(
+        "rocket_eventloop_busy_seconds_total{loop=\"%s\"} %.6f\n",
+        names[i].c_str(), stats[i].busy_ns / 1e9);
+  }
+
+  AppendHeader(out, "rocket_eventloop_wait_seconds_total", "counter",
+               "Time spent waiting in epoll_wait.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString(
+        "rocket_eventloop_wait_seconds_total{loop=\"%s\"} %.6f\n",
+        names[i].c_str(), stats[i].wait_ns / 1e9);
+  }
+
+  AppendHeader(out, "rocket_eventloop_events_total", "counter",
+               "Events returned by epoll_wait.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_eventloop_events_total{loop=\"%s\"} %lu\n",
+                        names[i].c_str(), stats[i].event_count);
+  }
+
+  AppendHeader(out, "rocket_eventloop_pending_tasks", "gauge",
+               "Tasks waiting in the loop queue.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_eventloop_pending_tasks{loop=\"%s\"} %zu\n",
+                        names[i].c_str(), loops[i]->getPendingTaskCount());
+  }
+
+  AppendHeader(out, "rocket_eventloop_timers", "gauge",
+               "Pending timer events.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    out += formatString("rocket_eventloop_timers{loop=\"%s\"} %zu\n",
+                        names[i].c_str(), loops[i]->getTimerCount());
+  }
+
+  AppendHeader(out, "rocket_eventloop_iteration_busy_seconds", "summary",
+               "Time spent on events and tasks in one loop iteration.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    AppendSummary(out, "rocket_eventloop_iteration_busy_seconds",
+                  "loop=\"" + names[i] + "\"", loops[i]->getBusyHistogram());
+  }
+
+  AppendHeader(out, "rocket_eventloop_task_queue_delay_seconds", "summary",
+               "Delay from addTask to the start of the task.");
+  for (size_t i = 0; i < loops.size(); i++) {
+    AppendSummary(out, "rocket_eventloop_task_queue_delay_seconds",
+                  "loop=\"" + names[i] + "\"",
+                  loops[i]->getQueueDelayHistogram());
+  }
+
+  AppendHeader(out, "rocket_eventloop_stalls_total", "counter",
+               "Tasks that blocked a loop longer than stall_threshold.");
+  out += formatString("rocket_eventloop_stalls_total %lu\n",
+                      EventLoopWatchdog::GetStallCount());
+
+  AppendHeader(out, "rocket_tcp_buffer_bytes", "gauge",
+               "Memory held by connection read and write buffers.");
+  out += formatString("rocket_tcp_buffer_bytes %ld\n",
+                      TcpBuffer::GetTotalBufferBytes());
+
+  AppendRpcMetrics(out, "server", RpcMetrics::GetServerMetrics());
+  AppendRpcMetrics(out, "client", RpcMetrics::GetClientMetrics());
+  AppendConcurrencyMetrics(out);
+
+  RpcDispatcher *dispatcher = RpcDispatcher::GetRpcDispatcherInstance();
+  AppendHeader(out, "rocket_rpc_server_deadline_exceeded_total", "counter",
+               "Requests dropped because the caller's deadline had passed.");
+  out += formatString(
+      "rocket_rpc_server_deadline_exceeded_total{stage=\"call\"} %lu\n",
+      dispatcher->getExpiredBeforeCallCount());
+  out += formatString(
+      "rocket_rpc_server_deadline_exceeded_total{stage=\"response\"} %lu\n",
+      dispatcher->getExpiredBeforeResponseCount());
+  return out;
+}
+
+std::string TcpServer::dumpConnections() {
+  std::vector<std::pair<int, ConnectionSnapshot>> rows;
+  ScopeMutex<Mutex> lock(m_metrics_mutex);
+  for (size_t i = 0; i < m_connection_snapshots.size(); i++) {
+    for (auto &e : m_connection_snapshots[i]) {
+      rows.emplace_back(static_cast<int>(i), e);
+    }
+  }
+  lock.unlock();
+
+  std::sort(rows.begin(), rows.end(),
+            [](const std::pair<int, ConnectionSnapshot> &a,
+               const std::pair<int, ConnectionSnapshot> &b) {
+              return a.second.output_bytes > b.second.output_bytes;
+            });
+
+  std::string out = formatString(
+      "%-22s %5s %4s %12s %12s %10s %10s %10s %9s %9s %s\n", "peer", "fd",
+      "loop", "bytes_in", "bytes_out", "frames_in", "frames_out", "queued",
+      "idle_ms", "stall_ms", "state");
+  for (auto &row : rows) {
+    const ConnectionSnapshot &e = row.second;
+    out += formatString(
+        "%-22s %5d %4s %12lu %12lu %10lu %10lu %10d %9ld %9ld %s\n",
+        e.peer_addr.c_str(), e.fd, formatString("io%d", row.first).c_str(),
+        e.stats.bytes_in, e.stats.bytes_out, e.stats.frames_in,
+        e.stats.frames_out, e.output_bytes, e.idle_ms, e.stall_ms,
+        e.is_throttled ? "throttled" : (e.is_read_paused ? "paused" : "ok"));
+  }
+  return out;
+}
+
 }  // namespace rocket
\ No newline at end of file
@@ -1,10 +1,15 @@
 #ifndef ROCKET_NET_TCP_TCP_SERVER_H
 #define ROCKET_NET_TCP_TCP_SERVER_H
+#include "rocket/common/mutex.h"
 #include "rocket/net/io_thread_group.h"
+#include "rocket/net/timer_event.h"
+#include "rocket/net/tcp/admin_server.h"
 #include "rocket/net/tcp/net_addr.h"
 #include "rocket/net/tcp/tcp_accepter.h"
 #include "rocket/net/tcp/tcp_connection.h"
 #include <set>
+#include <string>
+#include <vector>
 
 namespace rocket {
 class TcpServer {
@@ -16,18 +21,60 @@ public:
   // 启动TcpServer
   void start();
 
+  // subReactor的IO线程使用忙轮询模式，需在start之前调用
+  void setBusyPoll(int spin_budget_us, int socket_busy_poll_us = 0);
+
+  // 在admin_addr上提供管理接口(GET /metrics)，需在start之前调用。
+  // 没有调用时按配置的 admin_port 监听 127.0.0.1
+  void enableAdmin(NetAddr::s_ptr admin_addr);
+
+  // Prometheus 文本格式的运行指标: 各个loop的连接数、忙碌比例、队列长度、
+  // 定时任务数，TcpBuffer内存，以及服务端和客户端各方法的调用统计
+  std::string dumpMetrics();
+
+  // 各个连接的流量、积压和空闲时间，按积压的字节数从大到小排列，
+  // 每秒在IO线程中采集一次
+  std::string dumpConnections();
+
 private:
   void init();
   void onAccept();
 
+  // 定时在各个IO线程中检查连接: 检测慢客户端，采集统计信息，
+  // 已关闭的连接交回主线程从 m_clients 中移除
+  void onSweep();
+
+  // 在io_threads[loop_index]的线程中执行
+  void sweepConnections(int loop_index,
+                        const std::vector<TcpConnection::s_ptr> &connections);
+
+private:
+  struct ConnectionSnapshot {
+    std::string peer_addr;
+    int fd{-1};
+    TcpConnectionStats stats;
+    int output_bytes{0};
+    int64_t idle_ms{0};
+    int64_t stall_ms{0};
+    bool is_throttled{false};
+    bool is_read_paused{false};
+  };
+
 private:
   TcpAccepter::s_ptr m_accepter;             // TcpAccepter
   NetAddr::s_ptr m_local_addr;               // 本地监听的地址
   EventLoop *m_main_eventloop{nullptr};      // main reactor的eventloop
   IOThreadGroup *m_io_thread_group{nullptr}; // subReactor组
   FdEvent *m_listen_fd_event;                // server的listen event
-  int m_client_counts;                      // 已经建立连接的用户数量
+  int m_client_counts{0};                   // 已经建立连接的用户数量
   std::set<TcpConnection::s_ptr> m_clients; // 所有client的connection
+  TimerEvent::s_ptr m_sweep_timer_event;     // 定时检查连接
+
+  AdminServer::s_ptr m_admin_server;         // 管理接口
+  Mutex m_metrics_mutex; // 保护 m_last_loop_stats 和 m_connection_snapshots
+  std::vector<EpollStats> m_last_loop_stats; // 上次dump时各loop的统计
+  // 各IO线程最近一次采集的连接信息
+  std::vector<std::vector<ConnectionSnapshot>> m_connection_snapshots;
 };
 
 }; // namespace rocket
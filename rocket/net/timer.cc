@@ -124,6 +124,19 @@ void Timer::deleteTimerEvent(TimerEvent::s_ptr event) {
            event->getArriveTime());
 }
 
+int64_t Timer::getNextArriveTime() {
+  ScopeMutex<Mutex> lock(m_mutex);
+  if (m_pending_events.empty()) {
+    return -1;
+  }
+  return m_pending_events.begin()->first;
+}
+
+size_t Timer::getTimerEventCount() {
+  ScopeMutex<Mutex> lock(m_mutex);
+  return m_pending_events.size();
+}
+
 void Timer::resetArriveTime() {
   ScopeMutex<Mutex> lock(m_mutex);
   auto tmp = m_pending_events;
@@ -16,6 +16,11 @@ public:
   void onTimer(); // 当发生了IO事件后，event会执行该函数
   void resetArriveTime();
 
+  // 最近一个定时任务的到达时间(ms)，没有定时任务时返回-1
+  int64_t getNextArriveTime();
+
+  size_t getTimerEventCount();
+
 private:
   std::multimap<int64_t, TimerEvent::s_ptr> m_pending_events;
   Mutex m_mutex;
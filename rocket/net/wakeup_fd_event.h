@@ -1,5 +1,5 @@
 #ifndef ROCKET_NET_WAKEUP_FDEVENT_H
-#define ROCKET_EVENT_WAKE_UP_FD_H
+#define ROCKET_NET_WAKEUP_FDEVENT_H
 
 #include "rocket/net/fd_event.h"
 
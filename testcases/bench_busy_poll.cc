@@ -0,0 +1,184 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "order.pb.h"
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/common/util.h"
+#include "rocket/net/coder/tinypb_coder.h"
+#include "rocket/net/coder/tinypb_protocol.h"
+#include "rocket/net/rpc/rpc_dispatcher.h"
+#include "rocket/net/tcp/net_addr.h"
+#include "rocket/net/tcp/tcp_buffer.h"
+#include "rocket/net/tcp/tcp_server.h"
+
+// 对比 IO 线程阻塞模式和忙轮询模式下 makeOrder 的往返延迟
+// 用法: ./bench_busy_poll [请求数] [自旋预算us] [端口]
+
+// 与 test_rpc_server 相同的 Order 服务，去掉了 sleep，只测框架开销
+class OrderImpl : public Order {
+ public:
+  void makeOrder(google::protobuf::RpcController* controller,
+                 const ::makeOrderRequest* request,
+                 ::makeOrderResponse* response,
+                 ::google::protobuf::Closure* done) {
+    if (request->price() < 10) {
+      response->set_ret_code(-1);
+      response->set_res_info("short balance");
+      return;
+    }
+    response->set_order_id("20231028");
+  }
+};
+
+void run_server(int port, int spin_budget_us) {
+  auto service = std::make_shared<OrderImpl>();
+  rocket::RpcDispatcher::GetRpcDispatcherInstance()->registerService(service);
+
+  rocket::IPNetAddr::s_ptr addr =
+      std::make_shared<rocket::IPNetAddr>("127.0.0.1", port);
+  rocket::TcpServer tcp_server(addr);
+  if (spin_budget_us > 0) {
+    tcp_server.setBusyPoll(spin_budget_us);
+  }
+  tcp_server.start();
+}
+
+int connect_server(int port) {
+  sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  inet_aton("127.0.0.1", &server_addr.sin_addr);
+
+  // 等待子进程中的 server 启动
+  for (int i = 0; i < 100; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&server_addr),
+                sizeof(server_addr)) == 0) {
+      int val = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+      return fd;
+    }
+    close(fd);
+    usleep(50 * 1000);
+  }
+  return -1;
+}
+
+// 同步发送一个请求并等待回包，返回往返耗时(ns)，失败返回-1
+int64_t call_once(int fd, rocket::TinyPBCoder& coder, int index) {
+  auto message = std::make_shared<rocket::TinyPBProtocol>();
+  message->m_msg_id = std::to_string(100000000 + index);
+  message->m_method_name = "Order.makeOrder";
+  makeOrderRequest request;
+  request.set_price(100);
+  request.set_goods("apple");
+  request.SerializeToString(&message->m_pb_data);
+
+  std::vector<rocket::AbstractProtocol::s_ptr> messages{message};
+  auto out_buffer = std::make_shared<rocket::TcpBuffer>(256);
+  coder.encode(messages, out_buffer);
+
+  timespec begin, end;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  int len = out_buffer->readAble();
+  if (write(fd, &out_buffer->m_buffer[out_buffer->readIndex()], len) != len) {
+    return -1;
+  }
+
+  auto in_buffer = std::make_shared<rocket::TcpBuffer>(256);
+  std::vector<rocket::AbstractProtocol::s_ptr> responses;
+  while (responses.empty()) {
+    if (in_buffer->writeAble() == 0) {
+      in_buffer->resizeBuffer(2 * in_buffer->m_buffer.size());
+    }
+    int rt = read(fd, &in_buffer->m_buffer[in_buffer->writeIndex()],
+                  in_buffer->writeAble());
+    if (rt <= 0) {
+      return -1;
+    }
+    in_buffer->moveWriteIndex(rt);
+    coder.decode(responses, in_buffer);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - begin.tv_sec) * 1000000000L +
+         (end.tv_nsec - begin.tv_nsec);
+}
+
+void bench(const char* mode, int requests, int spin_budget_us, int port) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    run_server(port, spin_budget_us);
+    _exit(0);
+  }
+
+  int fd = connect_server(port);
+  if (fd < 0) {
+    printf("[%s] failed to connect server on port %d\n", mode, port);
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return;
+  }
+
+  rocket::TinyPBCoder coder;
+  std::vector<int64_t> latencies;
+  latencies.reserve(requests);
+
+  // 预热
+  for (int i = 0; i < 1000; i++) {
+    call_once(fd, coder, i);
+  }
+  for (int i = 0; i < requests; i++) {
+    int64_t ns = call_once(fd, coder, i);
+    if (ns < 0) {
+      printf("[%s] call failed at request %d\n", mode, i);
+      break;
+    }
+    latencies.push_back(ns);
+  }
+
+  close(fd);
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    size_t index = static_cast<size_t>(p * (latencies.size() - 1));
+    return latencies[index] / 1000.0;
+  };
+  printf("[%-8s] requests=%zu p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus\n",
+         mode, latencies.size(), percentile(0.5), percentile(0.99),
+         percentile(0.999), latencies.back() / 1000.0);
+}
+
+int main(int argc, char* argv[]) {
+  int requests = argc > 1 ? std::atoi(argv[1]) : 20000;
+  int spin_budget_us = argc > 2 ? std::atoi(argv[2]) : 200;
+  int port = argc > 3 ? std::atoi(argv[3]) : 12346;
+
+  // 只打印错误日志，fork 出的 server 进程沿用这里的配置
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+  rocket::Logger::InitGlobalLogger(0);
+
+  bench("blocking", requests, 0, port);
+  bench("busypoll", requests, spin_budget_us, port);
+  return 0;
+}
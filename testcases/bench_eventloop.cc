@@ -0,0 +1,255 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "rocket/common/config.h"
+#include "rocket/common/histogram.h"
+#include "rocket/common/log.h"
+#include "rocket/net/eventloop.h"
+#include "rocket/net/fd_event.h"
+#include "rocket/net/io_thread.h"
+#include "rocket/net/timer.h"
+#include "rocket/net/timer_event.h"
+
+// EventLoop 和 Timer 的微基准测试，每项输出一行可以直接对比的数字:
+//   addTask   多个线程向同一个 EventLoop 投递任务的吞吐
+//   wakeup    EventLoop 阻塞在 epoll_wait 时，从投递任务到任务开始执行的延迟
+//   timer     Timer::addTimerEvent / deleteTimerEvent 在不同定时器数量下的耗时
+//   dispatch  N 个空闲连接和 M 个活跃连接时每秒分发的事件数
+// 用法: ./bench_eventloop [addtask|wakeup|timer|dispatch]，不带参数时全部运行
+
+int64_t now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+struct AddTaskArg {
+  rocket::EventLoop *event_loop{nullptr};
+  std::atomic<uint64_t> *executed{nullptr};
+  int count{0};
+};
+
+void *add_task_producer(void *arg) {
+  AddTaskArg *task_arg = static_cast<AddTaskArg *>(arg);
+  std::atomic<uint64_t> *executed = task_arg->executed;
+  for (int i = 0; i < task_arg->count; i++) {
+    task_arg->event_loop->addTask(
+        [executed]() { executed->fetch_add(1, std::memory_order_relaxed); },
+        true);
+  }
+  return NULL;
+}
+
+void bench_add_task(int producers, int count) {
+  rocket::IOThread io_thread;
+  rocket::EventLoop *event_loop = io_thread.getEventLoop();
+  io_thread.start();
+
+  std::atomic<uint64_t> executed{0};
+  uint64_t total = static_cast<uint64_t>(producers) * count;
+  std::vector<pthread_t> tids(producers);
+  std::vector<AddTaskArg> args(producers);
+
+  int64_t begin = now_ns();
+  for (int i = 0; i < producers; i++) {
+    args[i].event_loop = event_loop;
+    args[i].executed = &executed;
+    args[i].count = count;
+    pthread_create(&tids[i], NULL, &add_task_producer, &args[i]);
+  }
+  for (int i = 0; i < producers; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  while (executed.load(std::memory_order_relaxed) < total) {
+    sched_yield();
+  }
+  int64_t end = now_ns();
+
+  printf(
+      "addTask   producers=%-2d tasks=%-8lu %10.0f tasks/s, saved wakeups "
+      "%lu\n",
+      producers, total, total * 1e9 / (end - begin),
+      event_loop->getSavedWakeupCount());
+
+  event_loop->stop();
+  io_thread.join();
+}
+
+void bench_wakeup(int count) {
+  rocket::IOThread io_thread;
+  rocket::EventLoop *event_loop = io_thread.getEventLoop();
+  io_thread.start();
+
+  rocket::LatencyHistogram latency;
+  std::atomic<int64_t> executed_at{0};
+  for (int i = 0; i < count; i++) {
+    // 等待loop回到epoll_wait中阻塞
+    usleep(100);
+    executed_at.store(0);
+    int64_t begin = now_ns();
+    event_loop->addTask([&executed_at]() { executed_at.store(now_ns()); },
+                        true);
+    while (executed_at.load() == 0) {
+    }
+    latency.record(executed_at.load() - begin);
+  }
+
+  printf("wakeup    count=%-8d p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus\n",
+         count, latency.percentile(50) / 1000.0,
+         latency.percentile(99) / 1000.0, latency.percentile(99.9) / 1000.0,
+         latency.max() / 1000.0);
+
+  event_loop->stop();
+  io_thread.join();
+}
+
+void bench_timer(int count) {
+  // 定时器到期时间分散在1分钟内，测试期间不会触发
+  std::mt19937 rng(count);
+  std::vector<rocket::TimerEvent::s_ptr> events;
+  events.reserve(count);
+  for (int i = 0; i < count; i++) {
+    events.push_back(std::make_shared<rocket::TimerEvent>(
+        1000 + rng() % 60000, false, []() {}));
+  }
+
+  rocket::Timer timer;
+  int64_t begin = now_ns();
+  for (auto &e : events) {
+    timer.addTimerEvent(e);
+  }
+  int64_t add_end = now_ns();
+
+  std::shuffle(events.begin(), events.end(), rng);
+  int64_t delete_begin = now_ns();
+  for (auto &e : events) {
+    timer.deleteTimerEvent(e);
+  }
+  int64_t end = now_ns();
+
+  printf("timer     timers=%-8d add %8.1f ns/op, delete %8.1f ns/op\n", count,
+         static_cast<double>(add_end - begin) / count,
+         static_cast<double>(end - delete_begin) / count);
+  close(timer.getFd());
+}
+
+// 把进程的fd上限提到硬上限，返回可用的fd数
+int raise_fd_limit() {
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  getrlimit(RLIMIT_NOFILE, &limit);
+  return static_cast<int>(std::min<rlim_t>(limit.rlim_cur, 1 << 20));
+}
+
+void bench_dispatch(int idle, int active, int seconds) {
+  rocket::IOThread io_thread;
+  rocket::EventLoop *event_loop = io_thread.getEventLoop();
+
+  // 每个连接用一个 eventfd 模拟，活跃连接的计数非0且回调中不读走，
+  // 水平触发下每次 epoll_wait 都会返回
+  std::atomic<uint64_t> dispatched{0};
+  std::vector<int> fds;
+  std::vector<std::unique_ptr<rocket::FdEvent>> events;
+  for (int i = 0; i < idle + active; i++) {
+    int fd = eventfd(i >= idle ? 1 : 0, EFD_NONBLOCK);
+    if (fd < 0) {
+      printf("eventfd error, errno=%d\n", errno);
+      exit(1);
+    }
+    fds.push_back(fd);
+    std::unique_ptr<rocket::FdEvent> event(new rocket::FdEvent(fd));
+    event->listen(rocket::FdEvent::IN_EVENT, [&dispatched]() {
+      dispatched.fetch_add(1, std::memory_order_relaxed);
+    });
+    event_loop->addEpollEvent(event.get());
+    events.push_back(std::move(event));
+  }
+
+  io_thread.start();
+  // 先让注册任务执行完
+  usleep(100 * 1000);
+  rocket::EpollStats before = event_loop->getEpollStats();
+  uint64_t dispatched_before = dispatched.load();
+  int64_t begin = now_ns();
+  sleep(seconds);
+  int64_t end = now_ns();
+  uint64_t total = dispatched.load() - dispatched_before;
+  rocket::EpollStats after = event_loop->getEpollStats();
+
+  uint64_t waits = after.wait_count - before.wait_count;
+  printf(
+      "dispatch  idle=%-6d active=%-4d %10.0f events/s %10.0f loops/s "
+      "%8.1f ns/event\n",
+      idle, active, total * 1e9 / (end - begin), waits * 1e9 / (end - begin),
+      total ? static_cast<double>(end - begin) / total : 0.0);
+
+  // 在loop线程中删除事件后再停止
+  std::atomic<bool> deleted{false};
+  event_loop->addTask(
+      [&events, event_loop, &deleted]() {
+        for (auto &e : events) {
+          event_loop->deleteEpollEvent(e.get());
+        }
+        deleted.store(true);
+      },
+      true);
+  while (!deleted.load()) {
+    sched_yield();
+  }
+  event_loop->stop();
+  io_thread.join();
+  for (int fd : fds) {
+    close(fd);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::string which = argc > 1 ? argv[1] : "all";
+
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+  rocket::Logger::InitGlobalLogger(0);
+
+  if (which == "all" || which == "addtask") {
+    bench_add_task(1, 1000000);
+    bench_add_task(4, 250000);
+    bench_add_task(16, 62500);
+  }
+  if (which == "all" || which == "wakeup") {
+    bench_wakeup(10000);
+  }
+  if (which == "all" || which == "timer") {
+    bench_timer(1000);
+    bench_timer(100000);
+    bench_timer(1000000);
+  }
+  if (which == "all" || which == "dispatch") {
+    // 留一些fd给epoll、timerfd等
+    int max_connections = raise_fd_limit() - 64;
+    int idles[] = {0, 1000, 10000};
+    int actives[] = {1, 100};
+    for (int idle : idles) {
+      for (int active : actives) {
+        if (idle + active > max_connections) {
+          printf("dispatch  idle=%-6d active=%-4d skipped, fd limit %d\n",
+                 idle, active, max_connections + 64);
+          continue;
+        }
+        bench_dispatch(idle, active, 1);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/common/msg_util.h"
+
+// 统计每个线程生成 msg_id 的速度
+// 用法: ./bench_msg_id [线程数] [每个线程生成的id数]
+
+struct BenchArg {
+  int count{0};
+  double string_ids_per_sec{0};
+  double number_ids_per_sec{0};
+};
+
+int64_t now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+void *bench(void *arg) {
+  BenchArg *bench_arg = static_cast<BenchArg *>(arg);
+  int count = bench_arg->count;
+
+  // 字符串形式，即 RpcChannel 中实际使用的方式
+  size_t total = 0;
+  int64_t begin = now_ns();
+  for (int i = 0; i < count; i++) {
+    total += rocket::MsgUtil::GetMsgID().size();
+  }
+  int64_t end = now_ns();
+  bench_arg->string_ids_per_sec = count * 1e9 / (end - begin);
+
+  // 只取数值
+  uint64_t sum = 0;
+  begin = now_ns();
+  for (int i = 0; i < count; i++) {
+    sum += rocket::MsgUtil::GetMsgIDNumber();
+  }
+  end = now_ns();
+  bench_arg->number_ids_per_sec = count * 1e9 / (end - begin);
+
+  // 防止循环被优化掉
+  if (total == 0 || sum == 1) {
+    printf("unexpected result\n");
+  }
+  return NULL;
+}
+
+// 检查同一线程生成的id长度正确且不重复
+bool check_unique(int count) {
+  std::set<std::string> ids;
+  for (int i = 0; i < count; i++) {
+    std::string id = rocket::MsgUtil::GetMsgID();
+    if (id.size() != rocket::MsgUtil::MSG_ID_LENGTH ||
+        !ids.insert(id).second) {
+      printf("bad msg_id [%s]\n", id.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+  int count = argc > 2 ? std::atoi(argv[2]) : 10000000;
+
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Logger::InitGlobalLogger(0);
+
+  if (!check_unique(100000)) {
+    return 1;
+  }
+
+  std::vector<pthread_t> tids(threads);
+  std::vector<BenchArg> args(threads);
+  for (int i = 0; i < threads; i++) {
+    args[i].count = count;
+    pthread_create(&tids[i], NULL, &bench, &args[i]);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+
+  for (int i = 0; i < threads; i++) {
+    printf("thread %d: GetMsgID %.1f M ids/s, GetMsgIDNumber %.1f M ids/s\n",
+           i, args[i].string_ids_per_sec / 1e6,
+           args[i].number_ids_per_sec / 1e6);
+  }
+  return 0;
+}
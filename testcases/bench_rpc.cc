@@ -0,0 +1,435 @@
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "order.pb.h"
+#include "rocket/common/config.h"
+#include "rocket/common/histogram.h"
+#include "rocket/common/log.h"
+#include "rocket/common/msg_util.h"
+#include "rocket/net/coder/tinypb_coder.h"
+#include "rocket/net/coder/tinypb_protocol.h"
+#include "rocket/net/rpc/rpc_dispatcher.h"
+#include "rocket/net/tcp/net_addr.h"
+#include "rocket/net/tcp/tcp_buffer.h"
+#include "rocket/net/tcp/tcp_server.h"
+
+// RPC 压测工具，通过回环地址对 Order.makeOrder 施压，输出 QPS 和延迟分布。
+// 默认在子进程中启动一个不 sleep 的 Order 服务，也可以用 -a 压测已经启动的服务。
+// 用法: ./bench_rpc [-a ip:port] [-c 连接数] [-n 每个连接的并发请求数]
+//                   [-s 请求payload字节数] [-r 总QPS] [-d 压测秒数]
+//                   [-w 预热秒数] [-t 子进程服务的IO线程数]
+// -r 为0时是闭环压测: 每个连接始终保持 n 个请求在途，收到回包立即发下一个；
+// -r 大于0时是开环压测: 按固定速率发送，不受 n 限制，延迟从计划发送时间算起，
+// 这样服务端变慢时不会因为压测端跟着变慢而低估延迟(coordinated omission)
+
+struct BenchOptions {
+  std::string ip{"127.0.0.1"};
+  int port{12347};
+  bool start_server{true};
+  int connections{4};
+  int concurrency{8};
+  int payload_size{64};
+  int rate{0};
+  int duration{10};
+  int warmup{2};
+  int server_io_threads{4};
+};
+
+struct BenchStats {
+  std::atomic<uint64_t> completed{0};  // 统计窗口内完成的请求数
+  std::atomic<uint64_t> errors{0};     // 回包错误或解析失败的请求数
+  std::atomic<uint64_t> unfinished{0};  // 压测结束时还没有回包的请求数
+  rocket::LatencyHistogram latency;   // ns
+};
+
+// 与 test_rpc_server 相同的 Order 服务，去掉了 sleep，并把payload原样带回
+class OrderImpl : public Order {
+ public:
+  void makeOrder(google::protobuf::RpcController* controller,
+                 const ::makeOrderRequest* request,
+                 ::makeOrderResponse* response,
+                 ::google::protobuf::Closure* done) {
+    if (request->price() < 10) {
+      response->set_ret_code(-1);
+      response->set_res_info("short balance");
+      return;
+    }
+    response->set_order_id("20231028");
+    response->set_res_info(request->goods());
+  }
+};
+
+int64_t now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+void run_server(const BenchOptions& options) {
+  rocket::Config::GetGlobalConfig()->m_io_threads = options.server_io_threads;
+
+  auto service = std::make_shared<OrderImpl>();
+  rocket::RpcDispatcher::GetRpcDispatcherInstance()->registerService(service);
+
+  rocket::IPNetAddr::s_ptr addr =
+      std::make_shared<rocket::IPNetAddr>(options.ip, options.port);
+  rocket::TcpServer tcp_server(addr);
+  tcp_server.start();
+}
+
+int connect_server(const BenchOptions& options) {
+  sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(options.port);
+  inet_aton(options.ip.c_str(), &server_addr.sin_addr);
+
+  // 等待服务启动
+  for (int i = 0; i < 100; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&server_addr),
+                sizeof(server_addr)) == 0) {
+      int val = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+      return fd;
+    }
+    close(fd);
+    usleep(50 * 1000);
+  }
+  return -1;
+}
+
+// 一个压测连接，由一个线程驱动，请求可以流水线发送，按 msg_id 匹配回包
+class BenchConnection {
+ public:
+  BenchConnection(const BenchOptions& options, BenchStats* stats,
+                  const std::string& request_data)
+      : m_options(options), m_stats(stats), m_request_data(request_data) {
+    m_in_buffer = std::make_shared<rocket::TcpBuffer>(64 * 1024);
+  }
+
+  ~BenchConnection() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  bool connect() {
+    m_fd = connect_server(m_options);
+    return m_fd >= 0;
+  }
+
+  void run(int64_t start, int64_t warmup_end, int64_t end) {
+    m_warmup_end = warmup_end;
+    bool open_loop = m_options.rate > 0;
+    int64_t interval = open_loop ? static_cast<int64_t>(m_options.connections) *
+                                       1000000000 / m_options.rate
+                                 : 0;
+    int64_t next_send = start;
+
+    while (true) {
+      int64_t now = now_ns();
+      if (now >= end) {
+        break;
+      }
+
+      std::vector<rocket::AbstractProtocol::s_ptr> messages;
+      if (open_loop) {
+        for (; next_send <= now; next_send += interval) {
+          messages.push_back(newRequest(next_send));
+        }
+      } else {
+        while (m_inflight.size() < static_cast<size_t>(m_options.concurrency)) {
+          messages.push_back(newRequest(now));
+        }
+      }
+      if (!messages.empty() && !sendRequests(messages)) {
+        printf("send request error, errno=%d, error=%s\n", errno,
+               strerror(errno));
+        return;
+      }
+
+      // 开环时最多等到下一次计划发送的时间
+      int64_t timeout = 100 * 1000000L;
+      if (open_loop) {
+        timeout = std::max<int64_t>(0, next_send - now_ns());
+      }
+      if (!waitResponses(timeout)) {
+        return;
+      }
+    }
+
+    // 等待在途请求的回包，最多等1s
+    int64_t drain_end = now_ns() + 1000000000L;
+    while (!m_inflight.empty() && now_ns() < drain_end) {
+      if (!waitResponses(10 * 1000000L)) {
+        break;
+      }
+    }
+    m_stats->unfinished.fetch_add(m_inflight.size());
+  }
+
+ private:
+  rocket::AbstractProtocol::s_ptr newRequest(int64_t send_time) {
+    auto message = std::make_shared<rocket::TinyPBProtocol>();
+    message->m_msg_id = rocket::MsgUtil::GetMsgID();
+    message->m_method_name = "Order.makeOrder";
+    message->m_pb_data = m_request_data;
+    m_inflight[message->m_msg_id] = send_time;
+    return message;
+  }
+
+  bool sendRequests(std::vector<rocket::AbstractProtocol::s_ptr>& messages) {
+    auto out_buffer = std::make_shared<rocket::TcpBuffer>(
+        messages.size() * (m_request_data.size() + 128));
+    m_coder.encode(messages, out_buffer);
+
+    int len = out_buffer->readAble();
+    const char* data = &out_buffer->m_buffer[out_buffer->readIndex()];
+    while (len > 0) {
+      int rt = write(m_fd, data, len);
+      if (rt < 0 && errno == EINTR) {
+        continue;
+      }
+      if (rt <= 0) {
+        return false;
+      }
+      data += rt;
+      len -= rt;
+    }
+    return true;
+  }
+
+  // 等待 timeout_ns 纳秒，有数据时读取并处理所有完整的回包
+  bool waitResponses(int64_t timeout_ns) {
+    pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    timespec ts;
+    ts.tv_sec = timeout_ns / 1000000000L;
+    ts.tv_nsec = timeout_ns % 1000000000L;
+    int rt = ppoll(&pfd, 1, &ts, nullptr);
+    if (rt <= 0) {
+      return rt == 0 || errno == EINTR;
+    }
+
+    if (m_in_buffer->writeAble() == 0) {
+      m_in_buffer->resizeBuffer(2 * m_in_buffer->m_buffer.size());
+    }
+    rt = read(m_fd, &m_in_buffer->m_buffer[m_in_buffer->writeIndex()],
+              m_in_buffer->writeAble());
+    if (rt <= 0) {
+      printf("connection closed by server\n");
+      return false;
+    }
+    m_in_buffer->moveWriteIndex(rt);
+
+    std::vector<rocket::AbstractProtocol::s_ptr> responses;
+    m_coder.decode(responses, m_in_buffer);
+    int64_t now = now_ns();
+    for (auto& response : responses) {
+      auto it = m_inflight.find(response->m_msg_id);
+      if (it == m_inflight.end()) {
+        continue;
+      }
+      int64_t send_time = it->second;
+      m_inflight.erase(it);
+
+      auto message = std::dynamic_pointer_cast<rocket::TinyPBProtocol>(response);
+      makeOrderResponse order_response;
+      if (message->m_err_code != 0 ||
+          !order_response.ParseFromString(message->m_pb_data) ||
+          order_response.ret_code() != 0) {
+        m_stats->errors++;
+        continue;
+      }
+      if (send_time >= m_warmup_end) {
+        m_stats->completed++;
+        m_stats->latency.record(now - send_time);
+      }
+    }
+    return true;
+  }
+
+ private:
+  const BenchOptions& m_options;
+  BenchStats* m_stats{nullptr};
+  const std::string& m_request_data;
+
+  int m_fd{-1};
+  int64_t m_warmup_end{0};
+  rocket::TinyPBCoder m_coder;
+  rocket::TcpBuffer::s_ptr m_in_buffer;
+  std::unordered_map<std::string, int64_t> m_inflight;  // msg_id -> 发送时间
+};
+
+struct ThreadArg {
+  BenchConnection* connection{nullptr};
+  int64_t start{0};
+  int64_t warmup_end{0};
+  int64_t end{0};
+};
+
+void* connection_thread(void* arg) {
+  ThreadArg* thread_arg = static_cast<ThreadArg*>(arg);
+  thread_arg->connection->run(thread_arg->start, thread_arg->warmup_end,
+                              thread_arg->end);
+  return NULL;
+}
+
+void usage(const char* name) {
+  printf(
+      "usage: %s [-a ip:port] [-c connections] [-n concurrency] "
+      "[-s payload_size] [-r rate] [-d duration] [-w warmup] "
+      "[-t server_io_threads]\n",
+      name);
+}
+
+bool parse_options(int argc, char* argv[], BenchOptions& options) {
+  int opt;
+  while ((opt = getopt(argc, argv, "a:c:n:s:r:d:w:t:h")) != -1) {
+    switch (opt) {
+      case 'a': {
+        std::string addr(optarg);
+        size_t pos = addr.find(':');
+        if (pos == std::string::npos) {
+          return false;
+        }
+        options.ip = addr.substr(0, pos);
+        options.port = std::atoi(addr.substr(pos + 1).c_str());
+        options.start_server = false;
+        break;
+      }
+      case 'c':
+        options.connections = std::atoi(optarg);
+        break;
+      case 'n':
+        options.concurrency = std::atoi(optarg);
+        break;
+      case 's':
+        options.payload_size = std::atoi(optarg);
+        break;
+      case 'r':
+        options.rate = std::atoi(optarg);
+        break;
+      case 'd':
+        options.duration = std::atoi(optarg);
+        break;
+      case 'w':
+        options.warmup = std::atoi(optarg);
+        break;
+      case 't':
+        options.server_io_threads = std::atoi(optarg);
+        break;
+      default:
+        return false;
+    }
+  }
+  return options.connections > 0 && options.concurrency > 0 &&
+         options.payload_size >= 0 && options.rate >= 0 &&
+         options.duration > 0 && options.warmup >= 0 &&
+         options.server_io_threads > 0;
+}
+
+int main(int argc, char* argv[]) {
+  BenchOptions options;
+  if (!parse_options(argc, argv, options)) {
+    usage(argv[0]);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  // 只打印错误日志，fork 出的 server 进程沿用这里的配置
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+  rocket::Logger::InitGlobalLogger(0);
+
+  pid_t pid = -1;
+  if (options.start_server) {
+    pid = fork();
+    if (pid == 0) {
+      run_server(options);
+      _exit(0);
+    }
+  }
+
+  makeOrderRequest request;
+  request.set_price(100);
+  request.set_goods(std::string(options.payload_size, 'x'));
+  std::string request_data;
+  request.SerializeToString(&request_data);
+
+  BenchStats stats;
+  std::vector<std::unique_ptr<BenchConnection>> connections;
+  for (int i = 0; i < options.connections; i++) {
+    connections.emplace_back(
+        new BenchConnection(options, &stats, request_data));
+    if (!connections.back()->connect()) {
+      printf("failed to connect server %s:%d\n", options.ip.c_str(),
+             options.port);
+      if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+      }
+      return 1;
+    }
+  }
+
+  printf(
+      "bench %s:%d, connections=%d, %s, payload=%d bytes, duration=%ds, "
+      "warmup=%ds\n",
+      options.ip.c_str(), options.port, options.connections,
+      options.rate > 0
+          ? rocket::formatString("open loop rate=%d/s", options.rate).c_str()
+          : rocket::formatString("closed loop concurrency=%d",
+                                 options.concurrency)
+                .c_str(),
+      options.payload_size, options.duration, options.warmup);
+
+  int64_t start = now_ns();
+  int64_t warmup_end = start + options.warmup * 1000000000L;
+  int64_t end = warmup_end + options.duration * 1000000000L;
+  std::vector<ThreadArg> args(options.connections);
+  std::vector<pthread_t> tids(options.connections);
+  for (int i = 0; i < options.connections; i++) {
+    args[i].connection = connections[i].get();
+    args[i].start = start;
+    args[i].warmup_end = warmup_end;
+    args[i].end = end;
+    pthread_create(&tids[i], NULL, &connection_thread, &args[i]);
+  }
+  for (int i = 0; i < options.connections; i++) {
+    pthread_join(tids[i], NULL);
+  }
+
+  if (pid > 0) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  }
+
+  printf("qps=%.1f, completed=%lu, errors=%lu, unfinished=%lu\n",
+         static_cast<double>(stats.completed.load()) / options.duration,
+         stats.completed.load(), stats.errors.load(),
+         stats.unfinished.load());
+  printf("latency(us): p50=%.1f p99=%.1f p999=%.1f max=%.1f\n",
+         stats.latency.percentile(50) / 1000.0,
+         stats.latency.percentile(99) / 1000.0,
+         stats.latency.percentile(99.9) / 1000.0, stats.latency.max() / 1000.0);
+  printf("%s", stats.latency.toPercentileDistribution(1000.0).c_str());
+  return 0;
+}
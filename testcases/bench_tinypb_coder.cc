@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/net/coder/tinypb_coder.h"
+#include "rocket/net/coder/tinypb_protocol.h"
+#include "rocket/net/tcp/tcp_buffer.h"
+
+// 统计 TinyPBCoder 在不同pb数据大小和分片方式下的编解码速度
+// 用法: ./bench_tinypb_coder [每轮的总字节数]
+// 分片方式模拟 TcpConnection 每次 read 到的数据量:
+//   whole  所有包一次性到达
+//   frame  每次刚好到达一个包
+//   mss    每次到达1448字节
+//   tiny   每次到达7字节，包头和字段会被切开
+
+int64_t now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+std::vector<rocket::AbstractProtocol::s_ptr> make_messages(int count,
+                                                           int payload_size) {
+  std::vector<rocket::AbstractProtocol::s_ptr> messages;
+  for (int i = 0; i < count; i++) {
+    auto message = std::make_shared<rocket::TinyPBProtocol>();
+    message->m_msg_id = std::to_string(10000000000000000000ULL + i);
+    message->m_method_name = "Order.makeOrder";
+    message->m_pb_data = std::string(payload_size, 'x');
+    messages.push_back(message);
+  }
+  return messages;
+}
+
+void bench_encode(int count, int payload_size) {
+  auto messages = make_messages(count, payload_size);
+  rocket::TinyPBCoder coder;
+
+  int64_t begin = now_ns();
+  auto out_buffer = std::make_shared<rocket::TcpBuffer>(128);
+  coder.encode(messages, out_buffer);
+  int64_t end = now_ns();
+
+  double seconds = (end - begin) / 1e9;
+  printf("encode  payload=%-6d            %10.0f frames/s %10.1f MB/s\n",
+         payload_size, count / seconds,
+         out_buffer->readAble() / seconds / 1024 / 1024);
+}
+
+// chunk_size 为0时每次写入一个完整的包，小于0时一次写入所有包
+void bench_decode(int count, int payload_size, const char *mode,
+                  int chunk_size) {
+  auto messages = make_messages(count, payload_size);
+  rocket::TinyPBCoder coder;
+  auto encoded = std::make_shared<rocket::TcpBuffer>(128);
+  coder.encode(messages, encoded);
+  const char *data = &encoded->m_buffer[encoded->readIndex()];
+  int total = encoded->readAble();
+  int frame_size = total / count;
+  if (chunk_size == 0) {
+    chunk_size = frame_size;
+  } else if (chunk_size < 0) {
+    chunk_size = total;
+  }
+
+  auto in_buffer =
+      std::make_shared<rocket::TcpBuffer>(chunk_size + frame_size);
+  std::vector<rocket::AbstractProtocol::s_ptr> out_messages;
+  out_messages.reserve(count);
+
+  int64_t begin = now_ns();
+  for (int offset = 0; offset < total; offset += chunk_size) {
+    int len = std::min(chunk_size, total - offset);
+    in_buffer->write2Buffer(data + offset, len);
+    coder.decode(out_messages, in_buffer);
+  }
+  int64_t end = now_ns();
+
+  if (static_cast<int>(out_messages.size()) != count) {
+    printf("decode error, expect %d frames, got %zu\n", count,
+           out_messages.size());
+    exit(1);
+  }
+  double seconds = (end - begin) / 1e9;
+  printf("decode  payload=%-6d chunk=%-6s %10.0f frames/s %10.1f MB/s\n",
+         payload_size, mode, count / seconds, total / seconds / 1024 / 1024);
+}
+
+int main(int argc, char *argv[]) {
+  int total_bytes = argc > 1 ? std::atoi(argv[1]) : 64 * 1024 * 1024;
+
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+  rocket::Logger::InitGlobalLogger(0);
+
+  int payload_sizes[] = {16, 256, 4096, 65536};
+  for (int payload_size : payload_sizes) {
+    int count = std::max(1000, total_bytes / (payload_size + 64));
+    bench_encode(count, payload_size);
+    bench_decode(count, payload_size, "whole", -1);
+    bench_decode(count, payload_size, "frame", 0);
+    bench_decode(count, payload_size, "mss", 1448);
+    bench_decode(std::max(1000, count / 16), payload_size, "tiny", 7);
+  }
+  return 0;
+}
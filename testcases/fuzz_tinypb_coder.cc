@@ -0,0 +1,218 @@
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/net/coder/tinypb_coder.h"
+#include "rocket/net/coder/tinypb_protocol.h"
+#include "rocket/net/tcp/tcp_buffer.h"
+
+// TinyPBCoder::decode 的模糊测试，输入任意字节，检查不会越界、崩溃，
+// 解出的包重新编码后能解出相同的内容。
+// 配合 libFuzzer 使用(推荐同时开启 AddressSanitizer):
+//   clang++ -std=c++17 -g -fsanitize=fuzzer,address -DROCKET_LIBFUZZER -I.
+//     testcases/fuzz_tinypb_coder.cc rocket/common/*.cc rocket/net/*.cc
+//     rocket/net/tcp/*.cc rocket/net/coder/*.cc rocket/net/rpc/*.cc
+//     -ltinyxml -lprotobuf -pthread -o fuzz_tinypb_coder
+//   ./fuzz_tinypb_coder corpus_dir
+// 不定义 ROCKET_LIBFUZZER 时编译为独立程序:
+//   ./fuzz_tinypb_coder [迭代次数]      用随机生成和变异的输入测试
+//   ./fuzz_tinypb_coder file1 file2 ... 重放 libFuzzer 保存的输入
+
+static void init_once() {
+  static bool g_inited = false;
+  if (!g_inited) {
+    g_inited = true;
+    rocket::Config::SetGlobalConfig(nullptr);
+    rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+    rocket::Logger::InitGlobalLogger(0);
+  }
+}
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "fuzz check failed: %s\n", what);
+    abort();
+  }
+}
+
+// 按 chunk_size 分片喂给decoder，模拟数据分多次到达
+static std::vector<rocket::AbstractProtocol::s_ptr> decode_in_chunks(
+    const uint8_t *data, size_t size, size_t chunk_size) {
+  rocket::TinyPBCoder coder;
+  auto buffer = std::make_shared<rocket::TcpBuffer>(64);
+  std::vector<rocket::AbstractProtocol::s_ptr> messages;
+  for (size_t offset = 0; offset < size; offset += chunk_size) {
+    size_t len = std::min(chunk_size, size - offset);
+    buffer->write2Buffer(reinterpret_cast<const char *>(data + offset), len);
+    coder.decode(messages, buffer);
+    check(buffer->readIndex() <= buffer->writeIndex(), "buffer index");
+  }
+  return messages;
+}
+
+static bool same_message(const rocket::TinyPBProtocol &a,
+                         const rocket::TinyPBProtocol &b) {
+  return a.m_msg_id == b.m_msg_id && a.m_method_name == b.m_method_name &&
+         a.m_err_code == b.m_err_code && a.m_err_info == b.m_err_info &&
+         a.m_pb_data == b.m_pb_data;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  init_once();
+
+  // 一次性到达和按首字节决定的分片大小到达，结果必须一致
+  auto whole = decode_in_chunks(data, size, size > 0 ? size : 1);
+  size_t chunk_size = size > 0 ? data[0] % 16 + 1 : 1;
+  auto chunked = decode_in_chunks(data, size, chunk_size);
+
+  for (auto &e : whole) {
+    auto message = std::dynamic_pointer_cast<rocket::TinyPBProtocol>(e);
+    check(message && message->parse_success, "parse_success");
+    check(message->m_pk_len >= rocket::TinyPBProtocol::MIN_PK_LEN &&
+              static_cast<size_t>(message->m_pk_len) <= size,
+          "pk_len range");
+    check(static_cast<size_t>(message->m_msg_id_len) ==
+                  message->m_msg_id.size() &&
+              static_cast<size_t>(message->m_method_name_len) ==
+                  message->m_method_name.size() &&
+              static_cast<size_t>(message->m_err_info_len) ==
+                  message->m_err_info.size(),
+          "field length");
+
+    // 重新编码后解码应得到相同的内容
+    if (!message->m_msg_id.empty()) {
+      rocket::TinyPBCoder coder;
+      auto copy = std::make_shared<rocket::TinyPBProtocol>(*message);
+      std::vector<rocket::AbstractProtocol::s_ptr> in{copy};
+      auto buffer = std::make_shared<rocket::TcpBuffer>(64);
+      coder.encode(in, buffer);
+      std::vector<rocket::AbstractProtocol::s_ptr> out;
+      coder.decode(out, buffer);
+      check(out.size() == 1, "round trip count");
+      check(same_message(*message,
+                         *std::dynamic_pointer_cast<rocket::TinyPBProtocol>(
+                             out[0])),
+            "round trip content");
+    }
+  }
+  check(chunked.size() == whole.size(), "chunked count");
+  for (size_t i = 0; i < whole.size(); i++) {
+    check(same_message(
+              *std::dynamic_pointer_cast<rocket::TinyPBProtocol>(whole[i]),
+              *std::dynamic_pointer_cast<rocket::TinyPBProtocol>(chunked[i])),
+          "chunked content");
+  }
+  return 0;
+}
+
+#ifndef ROCKET_LIBFUZZER
+
+// 生成一个随机的合法包
+static std::string random_frame(std::mt19937 &rng) {
+  auto message = std::make_shared<rocket::TinyPBProtocol>();
+  message->m_msg_id = std::to_string(rng());
+  message->m_method_name = rng() % 4 ? "Order.makeOrder" : "";
+  message->m_err_code = rng() % 8 ? 0 : static_cast<int32_t>(rng());
+  message->m_err_info = std::string(rng() % 8 ? 0 : rng() % 64, 'e');
+  message->m_pb_data = std::string(rng() % 256, static_cast<char>(rng()));
+
+  rocket::TinyPBCoder coder;
+  std::vector<rocket::AbstractProtocol::s_ptr> messages{message};
+  auto buffer = std::make_shared<rocket::TcpBuffer>(64);
+  coder.encode(messages, buffer);
+  return std::string(&buffer->m_buffer[buffer->readIndex()],
+                     buffer->readAble());
+}
+
+// 对输入做随机变异: 翻转比特、改写长度字段、截断、插入垃圾数据
+static void mutate(std::string &input, std::mt19937 &rng) {
+  int rounds = rng() % 4;
+  for (int i = 0; i < rounds && !input.empty(); i++) {
+    size_t pos = rng() % input.size();
+    switch (rng() % 5) {
+      case 0:
+        input[pos] ^= static_cast<char>(1 << (rng() % 8));
+        break;
+      case 1: {
+        // 把某个位置当作长度字段，写入一个极端值
+        static const int32_t values[] = {-1, 0, 1, 26, 0x7fffffff,
+                                         static_cast<int32_t>(0x80000000)};
+        int32_t value = htonl(values[rng() % 6]);
+        if (pos + sizeof(value) <= input.size()) {
+          memcpy(&input[pos], &value, sizeof(value));
+        }
+        break;
+      }
+      case 2:
+        input.resize(pos);
+        break;
+      case 3:
+        input.insert(pos, std::string(rng() % 8, static_cast<char>(rng())));
+        break;
+      default:
+        input[pos] = rng() % 2 ? rocket::TinyPBProtocol::PB_START
+                               : rocket::TinyPBProtocol::PB_END;
+        break;
+    }
+  }
+}
+
+static bool read_file(const char *path, std::string &content) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  content = ss.str();
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  init_once();
+
+  // 参数是文件时逐个重放
+  std::string content;
+  if (argc > 1 && read_file(argv[1], content)) {
+    for (int i = 1; i < argc; i++) {
+      if (!read_file(argv[i], content)) {
+        printf("failed to read %s\n", argv[i]);
+        return 1;
+      }
+      LLVMFuzzerTestOneInput(
+          reinterpret_cast<const uint8_t *>(content.data()), content.size());
+    }
+    printf("replayed %d inputs\n", argc - 1);
+    return 0;
+  }
+
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+  std::mt19937 rng(20231028);
+  for (int i = 0; i < iterations; i++) {
+    std::string input;
+    int frames = rng() % 4;
+    for (int j = 0; j < frames; j++) {
+      input += random_frame(rng);
+    }
+    if (rng() % 4 == 0) {
+      input += std::string(rng() % 64, static_cast<char>(rng()));
+    }
+    mutate(input, rng);
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()),
+                           input.size());
+  }
+  printf("fuzz %d iterations done\n", iterations);
+  return 0;
+}
+
+#endif
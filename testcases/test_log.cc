@@ -1,6 +1,8 @@
 #include "rocket/common/config.h"
 #include "rocket/common/log.h"
 #include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
 
 void *fun(void *) {
   int i = 20;
@@ -12,7 +14,71 @@ void *fun(void *) {
   return NULL;
 }
 
-int main() {
+int64_t now_ns() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// 统计单线程下每行日志的耗时(ns)，包括格式化和放入缓冲区。
+// 压测的行数远超线程缓冲区的容量，默认的丢弃策略下大部分日志会走丢弃路径，
+// 所以压测期间改为写满时等待异步日志线程，测出的是持续写日志的真实开销，
+// 同时打印丢弃的条数，不为0时结果不可信
+void bench_log(int count) {
+  rocket::Logger *logger = rocket::Logger::GetGlobalLogger();
+  logger->setFullPolicy(rocket::LogBlockOnFull);
+
+  // 对比: 只用 formatString 格式化日志内容，不含日志头和写缓冲区
+  int64_t begin = now_ns();
+  size_t total = 0;
+  for (int i = 0; i < count; i++) {
+    total += rocket::formatString("bench log line %d, msg [%s], cost [%.2f]",
+                                  i, "makeOrder", 1.5)
+                 .size();
+  }
+  int64_t end = now_ns();
+  printf("formatString   %d lines, %.1f ns/line\n", count,
+         static_cast<double>(end - begin) / count);
+
+  logger->setBinaryMode(false);
+  uint64_t drop_count = logger->getDropCount();
+  begin = now_ns();
+  for (int i = 0; i < count; i++) {
+    INFOLOG("bench log line %d, msg [%s], cost [%.2f]", i, "makeOrder", 1.5);
+  }
+  end = now_ns();
+  printf("INFOLOG text   %d lines, %.1f ns/line, dropped %lu\n", count,
+         static_cast<double>(end - begin) / count,
+         logger->getDropCount() - drop_count);
+
+  // 二进制模式下只写入格式串指针和参数，格式化在异步日志线程中完成
+  logger->setBinaryMode(true);
+  drop_count = logger->getDropCount();
+  begin = now_ns();
+  for (int i = 0; i < count; i++) {
+    INFOLOG("bench log line %d, msg [%s], cost [%.2f]", i, "makeOrder", 1.5);
+  }
+  end = now_ns();
+  printf("INFOLOG binary %d lines, %.1f ns/line, dropped %lu%s\n", count,
+         static_cast<double>(end - begin) / count,
+         logger->getDropCount() - drop_count,
+         logger->isBinaryMode() ? "" : " (binary mode needs async logger)");
+  logger->setBinaryMode(false);
+
+  // 级别被过滤掉的日志只有一次比较的开销
+  begin = now_ns();
+  for (int i = 0; i < count; i++) {
+    DEBUGLOG("bench log line %d, msg [%s], cost [%.2f]", i, "makeOrder", 1.5);
+  }
+  end = now_ns();
+  printf("DEBUGLOG       %d lines, %.1f ns/line (level %s)\n", count,
+         static_cast<double>(end - begin) / count,
+         rocket::LogLevelToString(logger->getLogLevel()).c_str());
+  logger->setFullPolicy(rocket::LogDropOnFull);
+  (void)total;
+}
+
+int main(int argc, char *argv[]) {
 
   rocket::Config::SetGlobalConfig("../conf/rocket.xml");
 
@@ -28,5 +94,10 @@ int main() {
   }
 
   pthread_join(thread, NULL);
+
+  // 用法: ./test_log [benchmark 日志行数]
+  if (argc > 1) {
+    bench_log(atoi(argv[1]));
+  }
   return 0;
-}
\ No newline at end of file
+}
@@ -21,6 +21,7 @@
 #include "rocket/net/rpc/rpc_closure.h"
 #include "rocket/net/rpc/rpc_controller.h"
 #include "rocket/net/rpc/rpc_dispatcher.h"
+#include "rocket/net/rpc/rpc_metrics.h"
 #include "rocket/net/tcp/net_addr.h"
 #include "rocket/net/tcp/tcp_client.h"
 #include "rocket/net/tcp/tcp_server.h"
@@ -96,6 +97,15 @@ void test_rpc_channel() {
               controller->getErrorInfo().c_str());
         }
 
+        for (auto &e : rocket::RpcMetrics::GetClientMetrics()->snapshot()) {
+          INFOLOG(
+              "client metrics [%s], requests %lu, errors %lu, inflight %ld, "
+              "request bytes %lu, response bytes %lu, p99 latency %.1fus",
+              e.method_name.c_str(), e.request_count, e.error_count,
+              e.inflight, e.request_bytes, e.response_bytes,
+              e.latency->percentile(99) / 1000.0);
+        }
+
         INFOLOG("now exit event loop");
         // channel->getTcpClient()->stop();
         channel.reset();
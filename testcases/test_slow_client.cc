@@ -0,0 +1,216 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "order.pb.h"
+#include "rocket/common/config.h"
+#include "rocket/common/log.h"
+#include "rocket/net/coder/tinypb_coder.h"
+#include "rocket/net/coder/tinypb_protocol.h"
+#include "rocket/net/rpc/rpc_dispatcher.h"
+#include "rocket/net/tcp/net_addr.h"
+#include "rocket/net/tcp/tcp_buffer.h"
+#include "rocket/net/tcp/tcp_connection.h"
+#include "rocket/net/tcp/tcp_server.h"
+
+// 慢客户端检测的测试，在子进程中启动 server，积压超过 SLOW_CLIENT_TIMEOUT_MS
+// 没有发出数据的连接会被关闭:
+// 1. 一直发送请求、读得比server写得慢但始终在读的客户端，发送缓冲区一直有积压，
+//    但不应该被关闭
+// 2. 发送请求后不再读取的客户端应该被关闭
+// 用法: ./test_slow_client [port]
+
+static const int SLOW_CLIENT_TIMEOUT_MS = 1000;
+// 响应要远多于内核socket缓冲区能容纳的数据，才会积压在server的发送缓冲区中
+static const int RESPONSE_PAYLOAD_SIZE = 4096;
+
+// 把请求的goods原样带回，响应的大小由客户端控制
+class OrderImpl : public Order {
+ public:
+  void makeOrder(google::protobuf::RpcController* controller,
+                 const ::makeOrderRequest* request,
+                 ::makeOrderResponse* response,
+                 ::google::protobuf::Closure* done) {
+    response->set_order_id("20231028");
+    response->set_res_info(request->goods());
+  }
+};
+
+void run_server(int port) {
+  rocket::TcpConnection::SetSlowClientPolicy(0, SLOW_CLIENT_TIMEOUT_MS,
+                                             rocket::SlowClientClose);
+  auto service = std::make_shared<OrderImpl>();
+  rocket::RpcDispatcher::GetRpcDispatcherInstance()->registerService(service);
+
+  rocket::IPNetAddr::s_ptr addr =
+      std::make_shared<rocket::IPNetAddr>("127.0.0.1", port);
+  rocket::TcpServer tcp_server(addr);
+  tcp_server.start();
+}
+
+int connect_server(int port) {
+  sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+  inet_aton("127.0.0.1", &server_addr.sin_addr);
+
+  // 等待子进程中的 server 启动
+  for (int i = 0; i < 100; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    // 接收缓冲区设小，让server很快产生积压
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&server_addr),
+                sizeof(server_addr)) == 0) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+      return fd;
+    }
+    close(fd);
+    usleep(50 * 1000);
+  }
+  return -1;
+}
+
+std::string make_requests(int count) {
+  rocket::TinyPBCoder coder;
+  std::vector<rocket::AbstractProtocol::s_ptr> messages;
+  for (int i = 0; i < count; i++) {
+    auto message = std::make_shared<rocket::TinyPBProtocol>();
+    message->m_msg_id = std::to_string(100000000 + i);
+    message->m_method_name = "Order.makeOrder";
+    makeOrderRequest request;
+    request.set_price(100);
+    request.set_goods(std::string(RESPONSE_PAYLOAD_SIZE, 'x'));
+    request.SerializeToString(&message->m_pb_data);
+    messages.push_back(message);
+  }
+  auto out_buffer = std::make_shared<rocket::TcpBuffer>(256);
+  coder.encode(messages, out_buffer);
+  return std::string(&out_buffer->m_buffer[out_buffer->readIndex()],
+                     out_buffer->readAble());
+}
+
+// 发送 batch，对端已经关闭连接时返回false
+bool send_batch(int fd, const std::string& batch) {
+  size_t sent = 0;
+  while (sent < batch.size()) {
+    int rt = write(fd, batch.data() + sent, batch.size() - sent);
+    if (rt > 0) {
+      sent += rt;
+      continue;
+    }
+    if (rt == -1 && errno == EAGAIN) {
+      usleep(1000);
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+// 最多读取 max_bytes，对端已经关闭连接时返回-1
+int read_some(int fd, int max_bytes) {
+  char buf[4096];
+  int total = 0;
+  while (total < max_bytes) {
+    int rt = read(fd, buf, sizeof(buf));
+    if (rt > 0) {
+      total += rt;
+      continue;
+    }
+    if (rt == -1 && errno == EAGAIN) {
+      break;
+    }
+    return -1;
+  }
+  return total;
+}
+
+// 一直发送请求，每10ms读取的数据少于server产生的响应，持续 timeout 的5倍时间
+bool test_reading_client(int port) {
+  int fd = connect_server(port);
+  if (fd < 0) {
+    printf("failed to connect server on port %d\n", port);
+    return false;
+  }
+  std::string batch = make_requests(20);
+  long total_read = 0;
+  for (int i = 0; i < SLOW_CLIENT_TIMEOUT_MS * 5 / 10; i++) {
+    int rt = send_batch(fd, batch) ? read_some(fd, 64 * 1024) : -1;
+    if (rt < 0) {
+      printf("[reading client] FAIL, closed by server after %d ms, "
+             "read %ld bytes\n",
+             i * 10, total_read);
+      close(fd);
+      return false;
+    }
+    total_read += rt;
+    usleep(10 * 1000);
+  }
+  close(fd);
+  printf("[reading client] PASS, read %ld bytes\n", total_read);
+  return true;
+}
+
+// 发送请求后不再读取，超时并经过一次连接检查后应该被关闭
+bool test_stalled_client(int port) {
+  int fd = connect_server(port);
+  if (fd < 0) {
+    printf("failed to connect server on port %d\n", port);
+    return false;
+  }
+  std::string batch = make_requests(100);
+  for (int i = 0; i < 50; i++) {
+    if (!send_batch(fd, batch)) {
+      break;
+    }
+  }
+  usleep((SLOW_CLIENT_TIMEOUT_MS + 2000) * 1000);
+
+  // 读完内核中缓存的响应后应该读到连接关闭
+  for (int i = 0; i < 300; i++) {
+    if (read_some(fd, 1024 * 1024) < 0) {
+      close(fd);
+      printf("[stalled client] PASS\n");
+      return true;
+    }
+    usleep(10 * 1000);
+  }
+  close(fd);
+  printf("[stalled client] FAIL, connection still open\n");
+  return false;
+}
+
+int main(int argc, char* argv[]) {
+  int port = argc > 1 ? std::atoi(argv[1]) : 12348;
+  signal(SIGPIPE, SIG_IGN);
+
+  // 只打印错误日志，fork 出的 server 进程沿用这里的配置
+  rocket::Config::SetGlobalConfig(nullptr);
+  rocket::Config::GetGlobalConfig()->m_log_level = "ERROR";
+  rocket::Logger::InitGlobalLogger(0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    run_server(port);
+    _exit(0);
+  }
+
+  bool ok = test_reading_client(port);
+  ok = test_stalled_client(port) && ok;
+
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  return ok ? 0 : 1;
+}